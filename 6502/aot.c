@@ -0,0 +1,265 @@
+/*******************************************************
+
+ENGINE_AOT: runs a program that's been translated to C
+ahead of time by translate.c.
+
+Images like the Sigma OS prog.txt don't change for
+months, so there's no point working the same things out
+every time they run. translate.c follows the program from
+the reset vector and writes out a C file with a function
+for every block it finds (a run of instructions up to a
+jump), which just calls the instruction bodies one after
+the other with the operands filled in. The bodies are all
+"static inline" here, so the compiler turns each block
+into straight code with nothing left of the fetching,
+decoding or dispatching.
+
+To use it:
+	gcc -o translate translate.c -lm -lpthread
+	./translate prog.txt prog_aot.c prog
+then in the host, after including cpu6502.h:
+	#include "prog_aot.c"
+	init_machine(&m, mem, 0, ENGINE_AOT, keyboard_addr);
+	use_aot(&m, &prog_aot);
+
+Anything translate.c couldn't follow (JMP_ID, RTS and RTI
+go wherever the stack says) or wasn't allowed to translate
+(the meta instructions talk to the host) gets run by the
+threaded engine until the program gets back to the start
+of a block. If the program writes over a block, that
+block never gets used again, so self modifying code still
+does the right thing. Tracing, breakpoints and run_until()
+conditions use the threaded engine for everything, like
+the JIT.
+
+The budgets work like the JIT's too: run_steps() is
+exact, run_for() can go up to a block over.
+
+*******************************************************/
+
+#define AOT_MAX_BLOCK 64 // The most instructions translate.c puts in one block
+#define AOT_MAX_SPAN (AOT_MAX_BLOCK * 4) // So the most bytes one can cover
+#define AOT_LOOKUP_SIZE 65536
+#define AOT_LOOKUP_MASK (AOT_LOOKUP_SIZE - 1)
+
+// One translated block. run() returns how many instructions it ran (it stops early if jit_exit gets set)
+struct aot_block {
+	uint32_t address;
+	uint32_t span; // How many bytes it was translated from
+	uint32_t count; // How many instructions are in it
+	uint32_t (*run)(struct machine *m);
+};
+
+// What translate.c makes
+struct aot_program {
+	const struct aot_block *blocks; // In order of address
+	uint32_t block_count;
+};
+
+// Every instruction body as aot_0xA9() and so on, for the translated code to call
+#define OP(opcode) static inline void PASTE(aot_, opcode)(struct machine *m, uint32_t operand) { \
+	struct data *data = &m -> data; \
+	uint8_t *mem = m -> mem; \
+	uint32_t *address = &data -> PC; \
+	uint8_t *keyboard_addr = m -> keyboard_addr; \
+	const uint8_t testing_mode = 0; \
+	INSTRUCTION_LOCALS \
+	INSTRUCTION_LOCALS_UNUSED \
+	(void) mem; (void) address; (void) keyboard_addr; (void) testing_mode; (void) operand; \
+	data -> cyclenum += instruction_cycles[opcode];
+#define END_OP }
+#define OP_BAIL return
+#define OPERAND_BYTE ((uint8_t) operand)
+#define OPERAND_ABS (*address += 2, operand)
+#define LOAD(a) load_byte(m, a)
+#define STORE(a, v) store_byte(m, a, v)
+#define WROTE(a, length) bytes_written(m, a, length)
+#define PUSH(v) push_byte(m, v, testing_mode)
+#define POP() pop_byte(m, testing_mode)
+#define SAVE_PROG() start_save(m)
+#define KEYBOARD_LINE() keyboard_line(m)
+#define WAIT_INPUT OP_BAIL // Never happens, the meta instructions are left to the threaded engine
+#include "instruction_bodies.c"
+#undef OP
+#undef END_OP
+
+/*
+Sets known[opcode] for every opcode that has a body, so translate.c knows what it can
+translate. Same trick as the threaded engine's table, nothing in here ever runs.
+*/
+void find_instructions(struct machine *m, uint8_t *known) {
+	struct data *data = &m -> data;
+	uint8_t *mem = m -> mem;
+	uint32_t *address = &data -> PC;
+	uint8_t *keyboard_addr = m -> keyboard_addr;
+	const uint8_t testing_mode = 0;
+	uint32_t operand = 0;
+	INSTRUCTION_LOCALS
+
+	memset(known, 0, 256);
+#define OP(opcode) known[opcode] = 1; if (0) {
+#define END_OP }
+#include "instruction_bodies.c"
+#undef OP
+#undef END_OP
+#undef OP_BAIL
+#undef OPERAND_BYTE
+#undef OPERAND_ABS
+#undef LOAD
+#undef STORE
+#undef WROTE
+#undef PUSH
+#undef POP
+#undef SAVE_PROG
+#undef KEYBOARD_LINE
+#undef WAIT_INPUT
+
+	return;
+}
+
+// Throws away anything left from the last program, the rest gets set up the first time it runs
+void use_aot(struct machine *m, const struct aot_program *program) {
+	free(m -> aot_disabled);
+	m -> aot_disabled = NULL;
+	free(m -> aot_lookup);
+	m -> aot_lookup = NULL;
+	for (uint32_t i = 0; i <= PAGE_COUNT; i++) {
+		m -> page_flags[i] &= ~PAGE_AOT;
+	}
+	m -> aot = program;
+
+	return;
+}
+
+// Returns 0 if there wasn't enough memory
+uint8_t start_aot(struct machine *m) {
+	const struct aot_program *program = m -> aot;
+
+	if (m -> aot_lookup != NULL) {
+		return 1;
+	}
+	m -> aot_disabled = (uint8_t*) calloc(program -> block_count + 1, 1);
+	m -> aot_lookup = (uint32_t*) calloc(AOT_LOOKUP_SIZE, sizeof(uint32_t));
+	if (m -> aot_disabled == NULL || m -> aot_lookup == NULL) {
+		perror("Failed to allocate memory for the translated program");
+		free(m -> aot_disabled);
+		m -> aot_disabled = NULL;
+		free(m -> aot_lookup);
+		m -> aot_lookup = NULL;
+		return 0;
+	}
+
+	// Writes to any of these pages have to check if they hit a block
+	for (uint32_t i = 0; i < program -> block_count; i++) {
+		const struct aot_block *block = &program -> blocks[i];
+		for (uint32_t page = block -> address >> PAGE_SHIFT; page <= (block -> address + block -> span - 1) >> PAGE_SHIFT; page++) {
+			m -> page_flags[page] |= PAGE_AOT;
+		}
+	}
+
+	return 1;
+}
+
+// The first block that starts after address
+uint32_t aot_search(const struct aot_program *program, uint32_t address) {
+	uint32_t low = 0, high = program -> block_count;
+
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		if (program -> blocks[middle].address <= address) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	return low;
+}
+
+// Returns NULL if there's no (usable) block starting at address
+const struct aot_block *find_aot_block(struct machine *m, uint32_t address) {
+	const struct aot_block *blocks = m -> aot -> blocks;
+	uint32_t *slot = &m -> aot_lookup[address & AOT_LOOKUP_MASK];
+
+	if (*slot == 0 || blocks[*slot - 1].address != address) {
+		uint32_t i = aot_search(m -> aot, address);
+		if (i == 0 || blocks[i - 1].address != address) {
+			return NULL;
+		}
+		*slot = i;
+	}
+	if (m -> aot_disabled[*slot - 1]) {
+		return NULL;
+	}
+
+	return &blocks[*slot - 1];
+}
+
+// Called when a PAGE_AOT page gets written to, stops using any block with that byte in it
+void aot_written(struct machine *m, uint32_t address) {
+	if (m -> aot == NULL || m -> aot_disabled == NULL) {
+		return;
+	}
+	const struct aot_block *blocks = m -> aot -> blocks;
+
+	for (uint32_t i = aot_search(m -> aot, address); i > 0 && address - blocks[i - 1].address < AOT_MAX_SPAN; i--) {
+		if (address < blocks[i - 1].address + blocks[i - 1].span && !m -> aot_disabled[i - 1]) {
+			m -> aot_disabled[i - 1] = 1;
+			m -> jit_exit = 1;
+		}
+	}
+
+	return;
+}
+
+uint8_t run_aot(RUN_ARGS) {
+	struct data *data = &m -> data;
+	uint8_t *mem = m -> mem;
+	uint32_t done = 0;
+	uint32_t stepped = 0; // Instructions the threaded engine ran (it counts those itself)
+	uint8_t reason = STOP_BUDGET;
+	uint8_t (*run_threaded)(RUN_ARGS) = (m -> testing_mode == 0) ? run_threaded_0 : run_threaded_traced;
+
+	if (m -> aot == NULL || m -> testing_mode > 0 || m -> breakpoint_count > 0 || condition != NULL || !start_aot(m)) {
+		return run_threaded(m, count, condition, ctx);
+	}
+
+	while (1) {
+		// Before looking at irq, so one that's raised after this still gets the translated code out
+		m -> jit_exit = 0;
+		// Anything that came in while it wasn't running (like an event going off, see events.c)
+		if (INTERRUPT_PENDING(m)) {
+			take_irq(m);
+		}
+		const struct aot_block *block = find_aot_block(m, data -> PC);
+
+		// Near the end of an instruction budget, go one at a time so it doesn't go over
+		if (block == NULL || count - done < block -> count) {
+			reason = run_threaded(m, 1, NULL, NULL);
+			done++;
+			stepped++;
+			if (reason != STOP_BUDGET) {
+				break;
+			}
+		} else {
+			done += block -> run(m);
+
+			if (INTERRUPT_PENDING(m)) {
+				take_irq(m);
+			}
+			if (m -> io_watching && mem[m -> io_watch] != m -> io_last) {
+				m -> io_last = mem[m -> io_watch];
+				reason = STOP_IO;
+				break;
+			}
+		}
+
+		if (done >= count || data -> cyclenum >= m -> run_end) {
+			reason = STOP_BUDGET;
+			break;
+		}
+	}
+	data -> instructions += done - stepped;
+
+	return reason;
+}
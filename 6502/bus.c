@@ -0,0 +1,123 @@
+/*******************************************************
+
+Memory mapped devices.
+
+Before this, a device (like the Sigma OS screen) was just
+some bytes of RAM, and the host had to stop the machine
+every time they changed and read them back out to find
+out what the program wanted. Now the host can put a
+device on the bus with add_device(), and it gets called
+when the program actually reads or writes its registers,
+straight from whatever engine is running.
+
+Every page (4KB, see machine.c) with a device in it gets
+PAGE_DEVICE, so the only thing the rest of memory pays
+for it is checking the page's flags, which writes already
+did anyway. A device's registers are still backed by
+memory: writes go into memory first and then get handed
+to write(), and reads without a read() just get whatever's
+in memory there (so a device can also just put things in
+memory for the program to read).
+
+What goes through the bus is the data instructions read
+and write. Fetching instructions and the pointers for
+indirect addressing come straight out of memory, and so
+do the reads in the read-modify-write instructions (INC,
+ASL and so on, their writes still go to the device).
+Zero page reads can't ever reach a device, so they don't
+check, which is why devices can't go in the zero page or
+the stack. execute() on its own doesn't know about
+devices either (it doesn't have a machine), so neither
+does the copy ENGINE_CHECKED checks against.
+
+A device that has state of its own (anything that isn't
+in memory) can tell device_state() where it is, and then
+snapshots (see snapshot.c) save and restore it along with
+everything else.
+
+A device can also interrupt the program with raise_irq()
+(see interrupts.c), from any thread, like the keyboard does when
+something gets typed (see keyboard.c), or with raise_nmi()
+for the one the program can't turn off (the timer can do
+either, see timer.c).
+
+*******************************************************/
+
+/*
+Puts a device on the bus for start to end (included). read and write can be NULL. Returns
+0 if there's no room for another one or it's somewhere it can't go.
+*/
+uint8_t add_device(struct machine *m, uint32_t start, uint32_t end,
+	uint8_t (*read)(struct machine *m, void *ctx, uint32_t address),
+	void (*write)(struct machine *m, void *ctx, uint32_t address, uint8_t value), void *ctx) {
+	struct device *device;
+
+	if (m -> device_count >= MAX_DEVICES || start > end || start <= STACK_RANGE[1] || end > MAX_MEM) {
+		return 0;
+	}
+	device = &m -> devices[m -> device_count];
+	m -> device_count++;
+	device -> start = start;
+	device -> end = end;
+	device -> read = read;
+	device -> write = write;
+	device -> ctx = ctx;
+	device -> state = NULL;
+	device -> state_size = 0;
+
+	for (uint32_t page = start >> PAGE_SHIFT; page <= end >> PAGE_SHIFT; page++) {
+		m -> page_flags[page] |= PAGE_DEVICE;
+	}
+
+	return 1;
+}
+
+// Returns NULL if there isn't one there (it's just memory that shares a page with one)
+struct device *find_device(struct machine *m, uint32_t address) {
+	for (uint8_t i = 0; i < m -> device_count; i++) {
+		if (address >= m -> devices[i].start && address <= m -> devices[i].end) {
+			return &m -> devices[i];
+		}
+	}
+
+	return NULL;
+}
+
+/*
+Tells snapshots that size bytes from state on are the state of the device at start (it
+has to be a plain block of bytes, no pointers). Returns 0 if there isn't a device there.
+*/
+uint8_t device_state(struct machine *m, uint32_t start, void *state, uint32_t size) {
+	struct device *device = find_device(m, start);
+
+	if (device == NULL) {
+		return 0;
+	}
+	device -> state = state;
+	device -> state_size = size;
+
+	return 1;
+}
+
+uint8_t device_read(struct machine *m, uint32_t address) {
+	struct device *device = find_device(m, address);
+
+	if (device == NULL || device -> read == NULL) {
+		return m -> mem[address];
+	}
+	// Whatever's reading it can't be skipped as an idle loop, the answer might change (see idle.c)
+	m -> idle_at = IDLE_NONE;
+
+	return device -> read(m, device -> ctx, address);
+}
+
+// Called after the program writes to a PAGE_DEVICE page
+void device_written(struct machine *m, uint32_t address) {
+	struct device *device = find_device(m, address);
+
+	if (device != NULL && device -> write != NULL) {
+		device -> write(m, device -> ctx, address, m -> mem[address]);
+	}
+
+	return;
+}
@@ -19,11 +19,12 @@ Helpful video: https://www.youtube.com/watch?v=qJgsuQoy9bc
 
 *******************************************************/
 
-#include <math.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
+#include <sys/stat.h>
 #include "instruction_set.c"
 
 // Memory (Change the ranges as you want but be prepared for seg faults and unexpected behaviour):
@@ -33,6 +34,19 @@ const uint32_t STACK_RANGE[2] = {0x000100, 0x0001FF};
 const uint32_t RAM_RANGE[2] = {0x000200, 0x0FFFFF}; // Little less than 1 megabyte of RAM
 const uint32_t ROM_RANGE[2] = {0x100000, 0xFFFFFF}; // 15 megabytes of ROM inc. sysmem (Not actually read only. This is just program memory.)
 
+/*
+With LAZY_FLAGS on, instructions don't work out Z, N and V when they set them, they
+just keep the value they'd be worked out from and the flags get worked out when
+something actually looks at them: branches, PHP/BRK (through getPS()) and the debug
+output. Most of the time the next instruction sets them again before anything looks.
+C gets a byte of its own too. That way setting flags is just storing bytes, rather
+than reading, changing and writing back the bitfield byte every instruction. Always
+use the macros below for these four, data -> C, Z, N and V are out of date when it's on.
+*/
+#ifndef LAZY_FLAGS
+#define LAZY_FLAGS 1
+#endif
+
 struct data {
 	uint8_t C : 1; // Carry
 	uint8_t Z : 1; // Zero
@@ -49,16 +63,47 @@ struct data {
     uint8_t exit_code;
 	uint8_t A, X, Y; // Accumulator, X, Y
 
-	uint32_t cyclenum;
+	uint64_t cyclenum; // Clock cycles since the last reset()
+	uint64_t instructions; // Instructions run since the last reset()
+
+#if LAZY_FLAGS
+	uint8_t c_result; // C is bit 0 of c_result
+	uint8_t z_result; // Z is (z_result == 0)
+	uint8_t n_result; // N is bit 7 of n_result
+	uint8_t v_result; // V is bit 7 of v_result
+#endif
 };
 
+// flag is cut down to 1 bit the same way it would be going into the bitfield
+#if LAZY_FLAGS
+#define SET_C(data, flag) ((data) -> c_result = (flag) & 1)
+#define SET_Z(data, flag) ((data) -> z_result = !((flag) & 1))
+#define SET_N(data, flag) ((data) -> n_result = ((flag) & 1) << 7)
+#define SET_V(data, flag) ((data) -> v_result = ((flag) & 1) << 7)
+#define SET_ZN(data, value) ((data) -> z_result = (data) -> n_result = (value)) // Z and N from an 8 bit result
+#define GET_C(data) ((data) -> c_result)
+#define GET_Z(data) ((data) -> z_result == 0)
+#define GET_N(data) ((data) -> n_result >> 7)
+#define GET_V(data) ((data) -> v_result >> 7)
+#else
+#define SET_C(data, flag) ((data) -> C = (flag))
+#define SET_Z(data, flag) ((data) -> Z = (flag))
+#define SET_N(data, flag) ((data) -> N = (flag))
+#define SET_V(data, flag) ((data) -> V = (flag))
+#define SET_ZN(data, value) ((data) -> Z = ((uint8_t) (value) == 0), (data) -> N = ((value) & 0b10000000) > 0)
+#define GET_C(data) ((data) -> C)
+#define GET_Z(data) ((data) -> Z)
+#define GET_N(data) ((data) -> N)
+#define GET_V(data) ((data) -> V)
+#endif
+
 uint8_t getPS(struct data data) {
 	uint8_t PS = 0;
 
-	if (data.C) {
+	if (GET_C(&data)) {
 		PS += 1;
 	}
-	if (data.Z) {
+	if (GET_Z(&data)) {
 		PS += 2;
 	}
 	if (data.I) {
@@ -73,10 +118,10 @@ uint8_t getPS(struct data data) {
 	if (data.clk) {
 		PS += 32;
 	}
-	if (data.V) {
+	if (GET_V(&data)) {
 		PS += 64;
 	}
-	if (data.N) {
+	if (GET_N(&data)) {
 		PS += 128;
 	}
 
@@ -84,13 +129,13 @@ uint8_t getPS(struct data data) {
 }
 
 void setPS(struct data *data, uint8_t PS) {
-	data -> C = (PS & 0b00000001) > 1;
-	data -> Z = (PS & 0b00000010) > 1;
+	SET_C(data, (PS & 0b00000001) != 0);
+	SET_Z(data, (PS & 0b00000010) > 1);
 	data -> I = (PS & 0b00000100) > 1;
 	data -> D = (PS & 0b00001000) > 1;
 	data -> B = (PS & 0b00010000) > 1;
-	data -> V = (PS & 0b01000000) > 1;
-	data -> N = (PS & 0b10000000) > 1;
+	SET_V(data, (PS & 0b01000000) > 1);
+	SET_N(data, (PS & 0b10000000) > 1);
 
 	return;
 }
@@ -142,6 +187,7 @@ uint32_t getAddr(struct data *data, uint32_t *address, uint8_t *mem) {
 	return (lowByte | (highByte << 8) | (highHighByte << 16));
 }
 
+// Memory from make_mem() is already all zeros, this is for memory from anywhere else
 uint8_t* initialise_mem(struct data data, uint8_t* mem) {
 	for (uint32_t i = RAM_RANGE[0]; i < RAM_RANGE[1]; i++) {
 		mem[i] = 0x00;
@@ -150,111 +196,19 @@ uint8_t* initialise_mem(struct data data, uint8_t* mem) {
 	return mem;
 }
 
+// Reads the hex number from string[0] to string[len] (so len is one less than how many digits there are)
 uint32_t hexToDec(char *string, int len) {
 	uint32_t val = 0;
 
-	for (int idx = 0; idx < len; idx++) { // yes I know this could be a for loop but idc
-		switch (string[idx]) {
-			case '1':
-				val += pow(16, len - idx);
-				break;
-			case '2':
-				val += pow(16, len - idx) * 2;
-				break;
-			case '3':
-				val += pow(16, len - idx) * 3;
-				break;
-			case '4':
-				val += pow(16, len - idx) * 4;
-				break;
-			case '5':
-				val += pow(16, len - idx) * 5;
-				break;
-			case '6':
-				val += pow(16, len - idx) * 6;
-				break;
-			case '7':
-				val += pow(16, len - idx) * 7;
-				break;
-			case '8':
-				val += pow(16, len - idx) * 8;
-				break;
-			case '9':
-				val += pow(16, len - idx) * 9;
-				break;
-			case 'a':
-				val += pow(16, len - idx) * 10;
-				break;
-			case 'b':
-				val += pow(16, len - idx) * 11;
-				break;
-			case 'c':
-				val += pow(16, len - idx) * 12;
-				break;
-			case 'd':
-				val += pow(16, len - idx) * 13;
-				break;
-			case 'e':
-				val += pow(16, len - idx) * 14;
-				break;
-			case 'f':
-				val += pow(16, len - idx) * 15;
-				break;
-			default:
-				break;
+	for (int idx = 0; idx <= len; idx++) {
+		val <<= 4;
+		if (string[idx] >= '0' && string[idx] <= '9') {
+			val += string[idx] - '0';
+		} else if (string[idx] >= 'a' && string[idx] <= 'f') {
+			val += string[idx] - 'a' + 10;
 		}
+		// Anything else counts as a 0, same as it always did
 	}
-	switch (string[len]) {
-		case '1':
-			val += 1;
-			break;
-		case '2':
-			val += 2;
-			break;
-		case '3':
-			val += 3;
-			break;
-		case '4':
-			val += 4;
-			break;
-		case '5':
-			val += 5;
-			break;
-		case '6':
-			val += 6;
-			break;
-		case '7':
-			val += 7;
-			break;
-		case '8':
-			val += 8;
-			break;
-		case '9':
-			val += 9;
-			break;
-		case 'a':
-			val += 10;
-			break;
-		case 'b':
-			val += 11;
-			break;
-		case 'c':
-			val += 12;
-			break;
-		case 'd':
-			val += 13;
-			break;
-		case 'e':
-			val += 14;
-			break;
-		case 'f':
-			val += 15;
-			break;
-		default:
-			break;
-		}
-
-		// yeah I know there are better ways to do this but I'm lazy and I just want to get this done
 
 	//printf("STRING: %s VAL: %06x LEN: %d\n", string, val, len);
 	return val;
@@ -295,1452 +249,312 @@ void loadProgFromFile(struct data data, uint8_t* mem, FILE *fp) {
 	return;
 }
 
+#define SAVE_BUFFER_SIZE 65536
+
+// Saving formats everything into one of these and writes it out in big chunks, rather than an fprintf() per byte
+struct save_buffer {
+	FILE *fptr;
+	uint32_t used;
+	char text[SAVE_BUFFER_SIZE];
+};
+
+const char HEX_DIGITS[16] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'a', 'b', 'c', 'd', 'e', 'f'};
+
+void flush_save(struct save_buffer *buffer) {
+	fwrite(buffer -> text, 1, buffer -> used, buffer -> fptr);
+	buffer -> used = 0;
+
+	return;
+}
+
+// "%02x;\n"
+static inline void save_value(struct save_buffer *buffer, uint8_t value) {
+	if (buffer -> used > SAVE_BUFFER_SIZE - 16) {
+		flush_save(buffer);
+	}
+	char *text = &buffer -> text[buffer -> used];
+	text[0] = HEX_DIGITS[value >> 4];
+	text[1] = HEX_DIGITS[value & 0xF];
+	text[2] = ';';
+	text[3] = '\n';
+	buffer -> used += 4;
+
+	return;
+}
+
+// "m%06x;\n"
+static inline void save_address(struct save_buffer *buffer, uint32_t address) {
+	if (buffer -> used > SAVE_BUFFER_SIZE - 16) {
+		flush_save(buffer);
+	}
+	char *text = &buffer -> text[buffer -> used];
+	text[0] = 'm';
+	for (uint8_t i = 0; i < 6; i++) {
+		text[1 + i] = HEX_DIGITS[(address >> (20 - i * 4)) & 0xF];
+	}
+	text[7] = ';';
+	text[8] = '\n';
+	buffer -> used += 9;
+
+	return;
+}
+
+// The first address from "from" up to (not including) "to" that isn't 0, or "to" if they all are
+uint32_t next_nonzero(const uint8_t *mem, uint32_t from, uint32_t to) {
+	while (from < to && (from & 63) != 0) {
+		if (mem[from] != 0) {
+			return from;
+		}
+		from++;
+	}
+	// 64 bytes at a time
+	while (to - from >= 64) {
+		uint64_t words[8];
+		memcpy(words, &mem[from], sizeof(words));
+		if ((words[0] | words[1] | words[2] | words[3] | words[4] | words[5] | words[6] | words[7]) != 0) {
+			break;
+		}
+		from += 64;
+	}
+	while (from < to && mem[from] == 0) {
+		from++;
+	}
+
+	return from;
+}
+
 void save(uint8_t *mem, FILE *fptr, uint32_t *range) {
+	struct save_buffer buffer;
 	uint32_t lastAddr = 0x000000;
 	uint32_t address = 0x000000;
+
+	buffer.fptr = fptr;
+	buffer.used = 0;
 	//printf("range: %06x to %06x\n", range[0], range[1]);
 	while (address < MAX_MEM) {
 		if (address >= range[0] && address <= range[1]) {
-			address++;
+			address = range[1] + 1;
+			continue;
+		}
+		if (mem[address] == 0 && (lastAddr == 0 || (address - lastAddr) > 16)) {
+			// Nothing gets saved until the next byte that isn't 0, so go straight there (or to the range)
+			address = next_nonzero(mem, address, (range[0] > address && range[0] < MAX_MEM) ? range[0] : MAX_MEM);
 			continue;
 		}
 		if (lastAddr == 0) {
-			if (mem[address] == 0) {
-				address++;
-				continue;
-			} else {
-				lastAddr = address;
-				fprintf(fptr, "m%06x;\n%02x;\n", address, mem[address]);
-				address++;
-				continue;
-			}
+			lastAddr = address;
+			save_address(&buffer, address);
+			save_value(&buffer, mem[address]);
+			address++;
+			continue;
 		}
 
 		if (mem[address] == 0) {
-			if ((address - lastAddr) > 16) {
+			uint8_t print = 0;
+			uint32_t savedAddress = address;
+			for (int i = 0; i < 16; i++) {
 				address++;
-				continue;
-			} else {
-				uint8_t print = 0;
-				uint32_t savedAddress = address;
-				for (int i = 0; i < 16; i++) {
-					address++;
-					if (mem[address] != 0) {
-						print = 1;
-						break;
-					}
-				}
-				address = savedAddress;
-				if (print) {
-					fprintf(fptr, "%02x;\n", mem[address]);
-					address++;
-				} else {
-					lastAddr -= 16;
+				if (mem[address] != 0) {
+					print = 1;
+					break;
 				}
-				continue;
 			}
+			address = savedAddress;
+			if (print) {
+				save_value(&buffer, mem[address]);
+				address++;
+			} else {
+				lastAddr -= 16;
+			}
+			continue;
 		}
 
 		if ((address - lastAddr) > 16) {
-			fprintf(fptr, "m%06x;\n%02x;\n", address, mem[address]);
+			save_address(&buffer, address);
+			save_value(&buffer, mem[address]);
 			lastAddr = address;
 			address++;
 			continue;
 		}
 		
-		fprintf(fptr, "%02x;\n", mem[address]);
+		save_value(&buffer, mem[address]);
 		lastAddr = address;
 		address++;
 	}
+	flush_save(&buffer);
 
 	return;
 }
 
+/*
+Opens a new temporary file next to path (its name goes in temp_path) to write something
+that's going to get renamed over path once it's all there, so nothing ever sees half of
+one. Returns NULL if it couldn't.
+*/
+FILE *open_temp(const char *path, char *temp_path, size_t size) {
+	// Every one gets its own name, so two at once can't get mixed up
+	if ((size_t) snprintf(temp_path, size, "%s.XXXXXX", path) >= size) {
+		return NULL;
+	}
+	int fd = mkstemp(temp_path);
+	if (fd < 0) {
+		return NULL;
+	}
+	fchmod(fd, 0644); // mkstemp() makes it so only we can read it
+	FILE *fptr = fdopen(fd, "wb");
+	if (fptr == NULL) {
+		close(fd);
+		remove(temp_path);
+	}
+
+	return fptr;
+}
+
+// What MTA_SAV_IP/MTA_OFS_IP leave out of prog.txt (the RAM)
+const uint32_t SAVE_SKIP[2] = {0x000000, 0x0fffff};
+
+/*
+Saves everything but SAVE_SKIP to prog.txt, the way MTA_SAV_IP/MTA_OFS_IP do. It gets
+written to a temporary file and renamed over prog.txt once it's all on the disk, so
+prog.txt is always either the old one or the new one, even if something crashes.
+Returns 0 if it couldn't (prog.txt's left as it was).
+*/
+uint8_t save_prog(uint8_t *mem) {
+	char temp_path[300];
+	uint32_t range[2] = {SAVE_SKIP[0], SAVE_SKIP[1]};
+
+	FILE *fptr = open_temp("prog.txt", temp_path, sizeof(temp_path));
+	if (fptr == NULL) {
+		return 0;
+	}
+	save(mem, fptr, range);
+
+	uint8_t failed = (fflush(fptr) != 0 || fsync(fileno(fptr)) != 0);
+	failed |= (fclose(fptr) != 0);
+	if (failed || rename(temp_path, "prog.txt") != 0) {
+		remove(temp_path);
+		return 0;
+	}
+
+	return 1;
+}
+
 void reset(struct data *data, uint8_t *mem) {
 	data -> clk = 1;
 	uint32_t temp = 0xFFFFFA;
 	data -> PC = getAddr(data, &temp, mem);
 	data -> cyclenum = 0;
+	data -> instructions = 0;
 	data -> exit_code = 0;
 
 	return;
 }
 
-void execute(struct data *data, uint8_t *mem, uint32_t *address, uint8_t testing_mode, uint8_t *keyboard_addr) {
-	if (testing_mode > 0) {
-		printf("Instruction: %02x\n", mem[*address]);
-		printf("Address: %06x\n", *address);
+/*
+How many cycles every instruction takes. Whatever runs the bodies adds these on as it
+starts each instruction, and the bodies add the rest: 1 for a branch that's taken,
+and 1 more for going onto another page (256 bytes) when a branch is taken or an
+indexed read (AX, AY, IY) has to carry into the high byte. Writes and read-modify-
+writes always take the long way round, so theirs are all in here.
+*/
+const uint8_t instruction_cycles[256] = {
+	[MTA_OFF_IP] = 1, [MTA_OFS_IP] = 1, [MTA_KYB_IP] = 10, [INS_BRK_IP] = 7, [INS_RTI_IP] = 6, [INS_NOP_IP] = 2,
+	[INS_CLD_IP] = 2, [INS_CLC_IP] = 2, [INS_CLI_IP] = 2, [INS_CLV_IP] = 2, [INS_SED_IP] = 2, [INS_SEC_IP] = 2,
+	[INS_SEI_IP] = 2, [INS_JMP_AB] = 3, [INS_JMP_ID] = 5, [INS_JSR_AB] = 6, [INS_RTS_IP] = 6,
+
+	[INS_STA_ZP] = 3, [INS_STA_ZX] = 4, [INS_STA_AB] = 4, [INS_STA_AX] = 5, [INS_STA_AY] = 5, [INS_STA_IX] = 6,
+	[INS_STA_IY] = 6, [INS_STX_ZP] = 3, [INS_STX_ZY] = 4, [INS_STX_AB] = 4, [INS_STY_ZP] = 3, [INS_STY_ZX] = 4,
+	[INS_STY_AB] = 4,
+
+	[INS_TAX_IP] = 2, [INS_TAY_IP] = 2, [INS_TYA_IP] = 2, [INS_TXA_IP] = 2, [INS_TSX_IP] = 2, [INS_TXS_IP] = 2,
+	[INS_DEX_IP] = 2, [INS_DEY_IP] = 2, [INS_INX_IP] = 2, [INS_INY_IP] = 2,
+	[INS_PHA_IP] = 3, [INS_PHP_IP] = 3, [INS_PLA_IP] = 4, [INS_PLP_IP] = 4,
+
+	[INS_DEC_ZP] = 5, [INS_DEC_ZX] = 6, [INS_DEC_AB] = 6, [INS_DEC_AX] = 7,
+	[INS_INC_ZP] = 5, [INS_INC_ZX] = 6, [INS_INC_AB] = 6, [INS_INC_AX] = 7,
+	[INS_ROL_AC] = 2, [INS_ROL_ZP] = 5, [INS_ROL_ZX] = 6, [INS_ROL_AB] = 6, [INS_ROL_AX] = 7,
+	[INS_ROR_AC] = 2, [INS_ROR_ZP] = 5, [INS_ROR_ZX] = 6, [INS_ROR_AB] = 6, [INS_ROR_AX] = 7,
+	[INS_ASL_AC] = 2, [INS_ASL_ZP] = 5, [INS_ASL_ZX] = 6, [INS_ASL_AB] = 6, [INS_ASL_AX] = 7,
+	[INS_LSR_AC] = 2, [INS_LSR_ZP] = 5, [INS_LSR_ZX] = 6, [INS_LSR_AB] = 6, [INS_LSR_AX] = 7,
+
+	[INS_LDA_IM] = 2, [INS_LDA_ZP] = 3, [INS_LDA_ZX] = 4, [INS_LDA_AB] = 4, [INS_LDA_AX] = 4, [INS_LDA_AY] = 4,
+	[INS_LDA_IX] = 6, [INS_LDA_IY] = 5, [INS_LDX_IM] = 2, [INS_LDX_ZP] = 3, [INS_LDX_ZY] = 4, [INS_LDX_AB] = 4,
+	[INS_LDX_AY] = 4, [INS_LDY_IM] = 2, [INS_LDY_ZP] = 3, [INS_LDY_ZX] = 4, [INS_LDY_AB] = 4, [INS_LDY_AX] = 4,
+
+	[INS_CMP_IM] = 2, [INS_CMP_ZP] = 3, [INS_CMP_ZX] = 4, [INS_CMP_AB] = 4, [INS_CMP_AX] = 4, [INS_CMP_AY] = 4,
+	[INS_CMP_IX] = 6, [INS_CMP_IY] = 5, [INS_CPX_IM] = 2, [INS_CPX_ZP] = 3, [INS_CPX_AB] = 4, [INS_CPY_IM] = 2,
+	[INS_CPY_ZP] = 3, [INS_CPY_AB] = 4, [INS_BIT_ZP] = 3, [INS_BIT_AB] = 4,
+
+	[INS_AND_IM] = 2, [INS_AND_ZP] = 3, [INS_AND_ZX] = 4, [INS_AND_AB] = 4, [INS_AND_AX] = 4, [INS_AND_AY] = 4,
+	[INS_AND_IX] = 6, [INS_AND_IY] = 5, [INS_EOR_IM] = 2, [INS_EOR_ZP] = 3, [INS_EOR_ZX] = 4, [INS_EOR_AB] = 4,
+	[INS_EOR_AX] = 4, [INS_EOR_AY] = 4, [INS_EOR_IX] = 6, [INS_EOR_IY] = 5, [INS_ORA_IM] = 2, [INS_ORA_ZP] = 3,
+	[INS_ORA_ZX] = 4, [INS_ORA_AB] = 4, [INS_ORA_AX] = 4, [INS_ORA_AY] = 4, [INS_ORA_IX] = 6, [INS_ORA_IY] = 5,
+	[INS_ADC_IM] = 2, [INS_ADC_ZP] = 3, [INS_ADC_ZX] = 4, [INS_ADC_AB] = 4, [INS_ADC_AX] = 4, [INS_ADC_AY] = 4,
+	[INS_ADC_IX] = 6, [INS_ADC_IY] = 5, [INS_SBC_IM] = 2, [INS_SBC_ZP] = 3, [INS_SBC_ZX] = 4, [INS_SBC_AB] = 4,
+	[INS_SBC_AX] = 4, [INS_SBC_AY] = 4, [INS_SBC_IX] = 6, [INS_SBC_IY] = 5,
+
+	[INS_BVS_RL] = 4, [INS_BVC_RL] = 4, [INS_BCS_RL] = 4, [INS_BCC_RL] = 4, [INS_BEQ_RL] = 4, [INS_BMI_RL] = 4,
+	[INS_BNE_RL] = 4, [INS_BPL_RL] = 4,
+};
+
+// 1 if a and b are on different pages, for the extra cycles
+#define PAGE_CROSSED(a, b) ((((a) ^ (b)) >> 8) != 0)
+
+// Scratch variables used by the instruction bodies (see instruction_bodies.c)
+#define INSTRUCTION_LOCALS \
+	uint32_t temp, temp2, temp4, addr; \
+	uint32_t *temp1; \
+	uint8_t temp3, lowByte, highByte, highHighByte; \
+	uint16_t output;
+
+// For the bodies made into a function each (jit.c, aot.c), where most of them go unused
+#define INSTRUCTION_LOCALS_UNUSED \
+	(void) temp; (void) temp2; (void) temp4; (void) addr; (void) temp1; \
+	(void) temp3; (void) lowByte; (void) highByte; (void) highHighByte; (void) output;
+
+// Debug info printed before and after every instruction (whichever engine runs it)
+#define EXECUTE_PROLOGUE \
+	if (testing_mode > 0) { \
+		printf("Instruction: %02x\n", mem[*address]); \
+		printf("Address: %06x\n", *address); \
 	}
-	switch (mem[*address]) {
-		case MTA_OFF_IP:
-			data -> clk = 0;
-			data -> cyclenum += 1;
-			data -> C = 0;
-			break;
-		case MTA_SAV_IP:
-			uint32_t range[2];
-			range[0] = 0x000000;
-			range[1] = 0x0fffff;
-			FILE *fptr;
-			fptr = fopen("prog.txt", "w");
-			if (fptr == NULL) {
-				perror("AHHH ABORT ABORT FAILED TO OPEN FILE!!! AH!!!!");
-				return;
-			}
-			save(mem, fptr, range);
-			fclose(fptr);
-			break;
-		case MTA_OFS_IP:
-			range[0] = 0x000000;
-			range[1] = 0x0fffff;
-			fptr = fopen("prog.txt", "w");
-			if (fptr == NULL) {
-				perror("AHHH ABORT ABORT FAILED TO OPEN FILE!!! AH!!!!");
-				return;
-			}
-			save(mem, fptr, range);
-			fclose(fptr);
-			data -> clk = 0;
-			data -> cyclenum += 1;
-			break;
-		case MTA_KYB_IP:
-			fgets(keyboard_addr, 250, stdin);
-			data -> cyclenum += 10;
-			break;
-		case INS_BRK_IP:
-			uint32_t temp = 0xFFFFFD;
-			stackPush(data, mem, *address, testing_mode);
-			stackPush(data, mem, (*address >> 8), testing_mode);
-			stackPush(data, mem, (*address >> 16), testing_mode);
-			stackPush(data, mem, getPS(*data), testing_mode);
-			data -> B = 1;
-			*address = getAddr(data, &temp, mem);
-			data -> cyclenum += 7;
-			if (testing_mode > 1) {
-				printf("Interrupted to: %06x\n", *address);
-			}
-			break;
-		case INS_STA_ZP:
-			(*address)++;
-			mem[mem[*address]] = data -> A;
-			//printf("storing to: %02x\n", mem[*address]);
-			data -> cyclenum += 3;
-			break;
-		case INS_STA_ZX:
-			(*address)++;
-			mem[(mem[*address] + data -> X) & 0b11111111] = data -> A;
-			data -> cyclenum += 4;
-			break;
-		case INS_STA_AB:
-			(*address)++;
-			mem[getAddr(data, address, mem)] = data -> A;
-			data -> cyclenum += 4;
-			break;
-		case INS_STA_AX:
-			(*address)++;
-			temp = getAddr(data, address, mem) + data -> X;
-			mem[temp] = data -> A;
-			data -> cyclenum += 5;
-			break;
-		case INS_STA_AY:
-			(*address)++;
-			mem[getAddr(data, address, mem) + data -> Y] = data -> A;
-			data -> cyclenum += 5;
-			break;
-		case INS_STA_IX:
-			(*address)++;
-			temp = mem[(mem[*address] + data -> X) & 0b11111111];
-			mem[getAddr(data, &temp, mem)] = data -> A;
-			data -> cyclenum += 6;
-			break;
-		case INS_STA_IY:
-			(*address)++;
-			temp = mem[*address];
-			mem[getAddr(data, &temp, mem) + data -> Y] = data -> A;
-			data -> cyclenum += 6;
-			break;
-		case INS_RTI_IP:
-			setPS(data, stackPop(data, mem, testing_mode));
-			temp = stackPop(data, mem, testing_mode);
-			temp |= (stackPop(data, mem, testing_mode) << 8);
-			temp |= (stackPop(data, mem, testing_mode) << 16);
-			data -> PC = temp;
-			data -> cyclenum += 6;
-			break;
-		case INS_STX_ZP:
-			(*address)++;
-			mem[mem[*address]] = data -> X;
-			data -> cyclenum += 3;
-			break;
-		case INS_STX_ZY:
-			(*address)++;
-			mem[(mem[*address] + data -> Y) & 0b11111111] = data -> X;
-			data -> cyclenum += 4;
-			break;
-		case INS_STX_AB:
-			(*address)++;
-			mem[getAddr(data, address, mem)] = data -> X;
-			data -> cyclenum += 4;
-			break;
-		case INS_STY_AB:
-			(*address)++;
-			mem[getAddr(data, address, mem)] = data -> Y;
-			data -> cyclenum += 3;
-			break;
-		case INS_STY_ZP:
-			(*address)++;
-			mem[mem[*address]] = data -> Y;
-			data -> cyclenum += 4;
-			break;
-		case INS_STY_ZX:
-			(*address)++;
-			mem[(mem[*address] + data -> X) & 0b11111111] = data -> Y;
-			data -> cyclenum += 4;
-			break;
-		case INS_TAX_IP:
-			data -> X = data -> A;
-			data -> Z = (data -> X == 0);
-			data -> N = ((data -> X & 0b10000000) > 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_TAY_IP:
-			data -> Y = data -> A;
-			data -> Z = (data -> Y == 0);
-			data -> N = ((data -> Y & 0b10000000) > 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_TYA_IP:
-			data -> A = data -> Y;
-			data -> Z = (data -> A == 0);
-			data -> N = ((data -> A & 0b10000000) > 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_TXA_IP:
-			data -> A = data -> X;
-			data -> Z = (data -> A == 0);
-			data -> N = ((data -> A & 0b10000000) > 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_TSX_IP:
-			data -> X = data -> SP;
-			data -> Z = (data -> X == 0);
-			data -> N = ((data -> X & 0b10000000) > 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_TXS_IP:
-			data -> SP = data -> X;
-			data -> cyclenum += 2;
-			break;
-		case INS_DEC_ZP:
-			(*address)++;
-			mem[mem[*address]]--;
-			data -> cyclenum += 5;
-			break;
-		case INS_DEC_ZX:
-			(*address)++;
-			mem[(mem[*address] + data -> X) & 0b11111111]--;
-			data -> cyclenum += 6;
-			break;
-		case INS_DEC_AB:
-			(*address)++;
-			mem[getAddr(data, address, mem)]--;
-			data -> cyclenum += 6;
-			break;
-		case INS_DEC_AX:
-			(*address)++;
-			mem[getAddr(data, address, mem) + data -> X]--;
-			data -> cyclenum += 7;
-			break;
-		case INS_INC_ZP:
-			(*address)++;
-			temp = (uint32_t) mem[*address];
-			//printf("Incrementing address %06x at address %06x\n", temp, *address);
-			mem[temp]++;
-			data -> Z = (mem[temp] == 0);
-			data -> B = ((mem[temp] & 0b10000000) > 1);
-			data -> cyclenum += 5;
-			break;
-		case INS_INC_ZX:
-			(*address)++;
-			temp = (mem[*address] + data -> X) & 0b11111111;
-			mem[temp]++;
-			data -> Z = (mem[temp] == 0);
-			data -> B = ((mem[temp] & 0b10000000) > 1);
-			data -> cyclenum += 6;
-			break;
-		case INS_INC_AB:
-			(*address)++;
-			temp = getAddr(data, address, mem);
-			mem[temp]++;
-			data -> Z = (mem[temp] == 0);
-			data -> B = ((mem[temp] & 0b10000000) > 1);
-			data -> cyclenum += 6;
-			break;
-		case INS_INC_AX:
-			(*address)++;
-			temp = getAddr(data, address, mem) + data -> X;
-			mem[temp]++;
-			data -> Z = (mem[temp] == 0);
-			data -> B = ((mem[temp] & 0b10000000) > 1);
-			data -> cyclenum += 7;
-			break;
-		case INS_DEX_IP:
-			data -> X--;
-			data -> Z = (data -> X == 0);
-			data -> B = ((data -> X & 0b10000000)> 1);
-			data -> cyclenum += 2;
-			break;
-		case INS_INX_IP:
-			data -> X++;
-			data -> Z = (data -> X == 0);
-			data -> B = ((data -> X & 0b10000000) > 1);
-			data -> cyclenum += 2;
-			break;
-		case INS_DEY_IP:
-			data -> Y--;
-			data -> Z = (data -> Y == 0);
-			data -> B = ((data -> Y & 0b10000000) > 1);
-			data -> cyclenum += 2;
-			break;
-		case INS_INY_IP:
-			data -> Y++;
-			data -> Z = (data -> Y == 0);
-			data -> B = ((data -> Y & 0b10000000) > 1);
-			data -> cyclenum += 2;
-			break;
-		case INS_ROL_AC:
-			temp = (data -> A & 0b10000000);
-			data -> A <<= 1;
-			data -> A += data -> C;
-			data -> C = temp;
-			data -> Z = (data -> A == 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_ROL_ZP:
-			(*address)++;
-			temp = (mem[mem[*address]] & 0b10000000);
-			mem[mem[*address]] <<= 1;
-			mem[mem[*address]] += data -> C;
-			data -> C = temp;
-			data -> Z = (mem[mem[*address]] & 0b10000000 == 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_ROL_ZX:
-			(*address)++;
-			temp = (mem[(mem[*address] + data -> X) & 0b11111111] & 0b10000000);
-			mem[(mem[*address] + data -> X) & 0b11111111] <<= 1;
-			mem[(mem[*address] + data -> X) & 0b11111111] += data -> C;
-			data -> C = temp;
-			data -> Z = (mem[(mem[*address] + data -> X) & 0b11111111] == 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_ROL_AB:
-			(*address)++;
-			uint32_t temp2 = getAddr(data, address, mem);
-			temp = (mem[temp2] & 0b10000000);
-			mem[temp2] <<= 1;
-			mem[temp2] += data -> C;
-			data -> C = temp;
-			data -> Z = (mem[temp2] == 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_ROL_AX:
-			(*address)++;
-			temp2 = getAddr(data, address, mem) + data -> X;
-			temp = (mem[temp2] & 0b10000000);
-			mem[temp2] <<= 1;
-			mem[temp2] += data -> C;
-			data -> C = temp;
-			data -> Z = (mem[temp2] == 0);
-			data -> cyclenum += 7;
-			break;
-		case INS_ROR_AC:
-			temp = (data -> A & 0b10000000);
-			data -> A >>= 1;
-			data -> A += data -> C;
-			data -> C = temp;
-			data -> Z = (data -> A == 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_ROR_ZP:
-			(*address)++;
-			temp = (mem[mem[*address]] & 0b10000000);
-			mem[mem[*address]] >>= 1;
-			mem[mem[*address]] += data -> C;
-			data -> C = temp;
-			data -> Z = (mem[mem[*address]] & 0b10000000 == 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_ROR_ZX:
-			(*address)++;
-			temp = (mem[(mem[*address] + data -> X) & 0b11111111] & 0b10000000);
-			mem[(mem[*address] + data -> X) & 0b11111111] >>= 1;
-			mem[(mem[*address] + data -> X) & 0b11111111] += data -> C;
-			data -> C = temp;
-			data -> Z = (mem[(mem[*address] + data -> X) & 0b11111111] == 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_ROR_AB:
-			(*address)++;
-			temp2 = getAddr(data, address, mem);
-			temp = (mem[temp2] & 0b10000000);
-			mem[temp2] >>= 1;
-			mem[temp2] += data -> C;
-			data -> C = temp;
-			data -> Z = (mem[temp2] == 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_ROR_AX:
-			(*address)++;
-			temp2 = getAddr(data, address, mem) + data -> X;
-			temp = (mem[temp2] & 0b10000000);
-			mem[temp2] >>= 1;
-			mem[temp2] += data -> C;
-			data -> C = temp;
-			data -> Z = (mem[temp2] == 0);
-			data -> cyclenum += 7;
-			break;
-		case INS_ASL_AC:
-			data -> C = ((data -> A & 0b10000000) > 0);
-			data -> A <<= 1;
-			data -> Z = (data -> A == 0);
-			data -> N = ((data -> A & 0b10000000) > 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_ASL_ZP:
-			uint32_t *temp1 = (uint32_t*) &(mem[mem[*address]]);
-			(*address)++;
-			data -> C = ((*temp1 & 0b10000000) > 0);
-			*temp1 <<= 1;
-			data -> Z = (*temp1 == 0);
-			data -> N = ((*temp1 & 0b10000000) > 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_ASL_ZX:
-			(*address)++;
-			temp1 = (uint32_t*) (uint8_t*) &(mem[mem[*address] + data -> X]);
-			data -> C = ((*temp1 & 0b10000000) > 0);
-			*temp1 <<= 1;
-			data -> Z = (*temp1 == 0);
-			data -> N = ((*temp1 & 0b10000000) > 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_ASL_AB:
-			(*address)++;
-			temp1 = (uint32_t*) &(mem[getAddr(data, address, mem)]);
-			data -> C = ((*temp1 & 0b10000000) > 0);
-			*temp1 <<= 1;
-			data -> Z = (*temp1 == 0);
-			data -> N = ((*temp1 & 0b10000000) > 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_ASL_AX:
-			(*address)++;
-			temp1 = (uint32_t*) &(mem[getAddr(data, address, mem) + data -> X]);
-			data -> C = ((*temp1 & 0b10000000) > 0);
-			*temp1 <<= 1;
-			data -> Z = (*temp1 == 0);
-			data -> N = ((*temp1 & 0b10000000) > 0);
-			data -> cyclenum += 7;
-			break;
-		case INS_LSR_AC:
-			data -> C = ((*temp1 & 0b00000001) > 0);
-			data -> A >> 1;
-			data -> Z = (*temp1 == 0);
-			data -> N = 0;
-			data -> cyclenum += 2;
-			break;
-		case INS_LSR_ZP:
-			temp1 = (uint32_t*) &(mem[mem[*address]]);
-			(*address)++;
-			data -> C = ((*temp1 & 0b00000001) > 0);
-			*temp1 >> 1;
-			data -> Z = (*temp1 == 0);
-			data -> N = 0;
-			data -> cyclenum += 5;
-			break;
-		case INS_LSR_ZX:
-			(*address)++;
-			temp1 = (uint32_t*) (uint8_t*) &(mem[mem[*address] + data -> X]);
-			data -> C = ((*temp1 & 0b00000001) > 0);
-			*temp1 >> 1;
-			data -> Z = (*temp1 == 0);
-			data -> N = 0;
-			data -> cyclenum += 6;
-			break;
-		case INS_LSR_AB:
-			(*address)++;
-			temp1 = (uint32_t*) &(mem[getAddr(data, address, mem)]);
-			data -> C = ((*temp1 & 0b00000001) > 0);
-			*temp1 >> 1;
-			data -> Z = (*temp1 == 0);
-			data -> N = 0;
-			data -> cyclenum += 6;
-			break;
-		case INS_LSR_AX:
-			(*address)++;
-			temp1 = (uint32_t*) &(mem[getAddr(data, address, mem) + data -> X]);
-			data -> C = ((*temp1 & 0b00000001) > 0);
-			*temp1 >> 1;
-			data -> Z = (*temp1 == 0);
-			data -> N = 0;
-			data -> cyclenum += 7;
-			break;
-		case INS_CMP_IM:
-			(*address)++;
-			temp = (uint8_t) (data -> A - mem[*address]);
-			if (testing_mode > 2) {
-				printf("Comparing A with %02x\n", mem[*address]);
-				printf("A is %02x\n", data -> A);
-			}
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_CMP_ZP:
-			(*address)++;
-			temp = (uint8_t) (data -> A - mem[mem[*address]]);
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 3;
-			break;
-		case INS_CMP_ZX:
-			(*address)++;
-			temp = (uint8_t) (data -> A - mem[(mem[*address] + data -> X) & 0b11111111]);
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_CMP_AB:
-			(*address)++;
-			temp = (uint8_t) (data -> A - mem[getAddr(data, address, mem)]);
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_CMP_AX:
-			(*address)++;
-			temp = (uint8_t) (data -> A - mem[getAddr(data, address, mem) + data -> X]);
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_CMP_AY:
-			(*address)++;
-			temp = (uint8_t) (data -> A - mem[getAddr(data, address, mem) + data -> Y]);
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_CMP_IX:
-			(*address)++;
-			uint8_t temp3 = mem[(mem[*address] + data -> X) & 0b11111111];
-			temp = (data -> A - mem[temp3]) & 0b11111111;
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_CMP_IY:
-			(*address)++;
-			uint32_t temp4 = mem[*address];
-			temp2 = getAddr(data, &temp4, mem) + data -> Y;
-			temp = (data -> A - mem[temp2]) & 0b11111111;
-			//printf("%02x%02x%02x\n", mem[0x000080], mem[0x000081], mem[0x000082]);
-			//printf("Comparing A with val at val at: %02x\n", temp4 - 2);
-			//printf("Comparing A with val at: %06x\n", temp2);
-			//printf("Comparing A with: %02x\n", mem[temp2]);
-			//printf("A is: %02x\n", data -> A);
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_CPX_IM:
-			(*address)++;
-			temp = (uint8_t) data -> X - mem[*address];
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_CPX_ZP:
-			(*address)++;
-			temp = (uint8_t) data -> X - mem[mem[*address]];
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 3;
-			break;
-		case INS_CPX_AB:
-			(*address)++;
-			temp = (uint8_t) data -> X - mem[*address];
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_CPY_IM:
-			(*address)++;
-			temp = (uint8_t) data -> Y - mem[*address];
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_CPY_ZP:
-			(*address)++;
-			temp = (uint8_t) data -> Y - mem[mem[*address]];
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 3;
-			break;
-		case INS_CPY_AB:
-			(*address)++;
-			temp = (uint8_t) data -> Y - mem[*address];
-			data -> N = ((temp & 0b10000000) > 0);
-			data -> C = ((temp & 0b10000000) == 0);
-			data -> Z = (temp == 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_AND_IM:
-			(*address)++;
-			data -> A = (data -> A & mem[*address]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_AND_ZP:
-			(*address)++;
-			data -> A = (data -> A & mem[mem[*address]]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 3;
-			break;
-		case INS_AND_ZX:
-			(*address)++;
-			data -> A = (data -> A & (uint8_t) (mem[mem[*address] + data -> X]));
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_AND_AB:
-			(*address)++;
-			data -> A = (data -> A & (uint8_t) mem[getAddr(data, address, mem)]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_AND_AX:
-			(*address)++;
-			data -> A = (data -> A & (uint8_t) mem[getAddr(data, address, mem) + data -> X]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_AND_AY:
-			(*address)++;
-			data -> A = (data -> A & (uint8_t) mem[getAddr(data, address, mem) + data -> Y]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_AND_IX:
-			(*address)++;
-			temp = (uint8_t) (mem[*address] + data -> X);
-			data -> A = (data -> A & mem[getAddr(data, &temp, mem)]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_AND_IY:
-			(*address)++;
-			temp = (mem[*address]) & 0b11111111;
-			data -> A = (data -> A & mem[(getAddr(data, &temp, mem) + data -> Y) & 0b11111111]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_EOR_IM:
-			(*address)++;
-			data -> A = (data -> A ^ mem[*address]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_EOR_ZP:
-			(*address)++;
-			data -> A = (data -> A ^ mem[mem[*address]]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 3;
-			break;
-		case INS_EOR_ZX:
-			(*address)++;
-			data -> A = (data -> A ^ (uint8_t) (mem[mem[*address] + data -> X]));
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_EOR_AB:
-			(*address)++;
-			data -> A = (data -> A ^ (uint8_t) mem[getAddr(data, address, mem)]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_EOR_AX:
-			(*address)++;
-			data -> A = (data -> A ^ (uint8_t) mem[getAddr(data, address, mem) + data -> X]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_EOR_AY:
-			(*address)++;
-			data -> A = (data -> A ^ (uint8_t) mem[getAddr(data, address, mem) + data -> Y]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_EOR_IX:
-			(*address)++;
-			temp = (uint8_t) (mem[*address] + data -> X);
-			data -> A = (data -> A ^ mem[getAddr(data, &temp, mem)]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_EOR_IY:
-			(*address)++;
-			temp = (mem[*address]) & 0b11111111;
-			data -> A = (data -> A ^ mem[(getAddr(data, &temp, mem) + data -> Y) & 0b11111111]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_ORA_IM:
-			(*address)++;
-			data -> A = (data -> A | mem[*address]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_ORA_ZP:
-			(*address)++;
-			data -> A = (data -> A | mem[mem[*address]]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 3;
-			break;
-		case INS_ORA_ZX:
-			(*address)++;
-			data -> A = (data -> A | (uint8_t) (mem[mem[*address] + data -> X]));
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_ORA_AB:
-			(*address)++;
-			data -> A = (data -> A | (uint8_t) mem[getAddr(data, address, mem)]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_ORA_AX:
-			(*address)++;
-			data -> A = (data -> A | (uint8_t) mem[getAddr(data, address, mem) + data -> X]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_ORA_AY:
-			(*address)++;
-			data -> A = (data -> A | (uint8_t) mem[getAddr(data, address, mem) + data -> Y]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_ORA_IX:
-			(*address)++;
-			temp = (uint8_t) (mem[*address] + data -> X);
-			data -> A = (data -> A | mem[getAddr(data, &temp, mem)]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_ORA_IY:
-			(*address)++;
-			temp = (mem[*address]) & 0b11111111;
-			data -> A = (data -> A | mem[(getAddr(data, &temp, mem) + data -> Y) & 0b11111111]);
-			data -> Z = (data -> A == 0);
-			data -> N = (data -> A & 0b10000000 > 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_PHA_IP:
-			stackPush(data, mem, data -> A, testing_mode);
-			data -> cyclenum += 3;
-			break;
-		case INS_PLA_IP:
-			data -> A = stackPop(data, mem, testing_mode);
-			data -> cyclenum += 4;
-			break;
-		case INS_PHP_IP:
-			stackPush(data, mem, getPS(*data), testing_mode);
-			data -> cyclenum += 3;
-			break;
-		case INS_PLP_IP:
-			setPS(data, stackPop(data, mem, testing_mode));
-			data -> cyclenum += 4;
-			break;
-		case INS_BVS_RL:
-			(*address)++;
-			if (data -> V) { 
-				if (mem[*address] & 0b10000000) 
-				{ 
-					*address -= mem[*address] & 0b01111111;
-				}
-				else
-				{  
-					*address += mem[*address] & 0b01111111;
-				} 
-				if (testing_mode > 1) {
-					printf("Branched to: %06x\n", *address);
-				}
-				data -> cyclenum += 1;
-			} else {
-				if (testing_mode > 1) {
-					printf("Failed to branch. Now at address:%06x\n", *address);
-				}
-			}
-			data -> cyclenum += 4;
-			break;
-		case INS_BVC_RL:
-			(*address)++;
-			if (!(data -> V)) { 
-				if (mem[*address] & 0b10000000) 
-				{ 
-					*address -= mem[*address] & 0b01111111;
-				} 
-				else 
-				{  
-					*address += mem[*address] & 0b01111111;
-				} 
-				if (testing_mode > 1) {
-					printf("Branched to: %06x\n", *address);
-				}
-				data -> cyclenum += 1;
-			} else {
-				if (testing_mode > 1) {
-					printf("Failed to branch. Now at address:%06x\n", *address);
-				}
-			}
-			data -> cyclenum += 4;
-			break;
-		case INS_BCS_RL:
-			(*address)++;
-			if (data -> C) { 
-				if (mem[*address] & 0b10000000) 
-				{ 
-					*address -= mem[*address] & 0b01111111;
-				} 
-				else 
-				{  
-					*address += mem[*address] & 0b01111111;
-				} 
-				if (testing_mode > 1) {
-					printf("Branched to: %06x\n", *address);
-				}
-				data -> cyclenum += 1;
-			} else {
-				if (testing_mode > 1) {
-					printf("Failed to branch. Now at address:%06x\n", *address);
-				}
-			}
-			data -> cyclenum += 4;
-			break;
-		case INS_BCC_RL:
-			(*address)++;
-			if (!(data -> C)) { 
-				if (mem[*address] & 0b10000000) 
-				{ 
-					*address -= mem[*address] & 0b01111111;
-				} 
-				else 
-				{  
-					*address += mem[*address] & 0b01111111;
-				} 
-				if (testing_mode > 1) {
-					printf("Branched to: %06x\n", *address);
-				}
-				data -> cyclenum += 1;
-			} else {
-				if (testing_mode > 1) {
-					printf("Failed to branch. Now at address:%06x\n", *address);
-				}
-			}
-			data -> cyclenum += 4;
-			break;
-		case INS_BEQ_RL:
-			(*address)++;
-			if (data -> Z) {
-				//printf("Branched from: %06x\n", *address);
-				if (mem[*address] & 0b10000000) 
-				{ 
-					*address -= mem[*address] & 0b01111111;
-				} 
-				else 
-				{  
-					*address += mem[*address] & 0b01111111;
-				}
-				if (testing_mode > 1) {
-					printf("Branched to: %06x\n", *address);
-				}
-				data -> cyclenum += 1;
-			} else {
-				if (testing_mode > 1) {
-					printf("Failed to branch. Now at address:%06x\n", *address);
-				}
-			}
-			data -> cyclenum += 4;
-			break;
-		case INS_BMI_RL:
-			(*address)++;
-			if (data -> N) { 
-				if (mem[*address] & 0b10000000) 
-				{ 
-					*address -= mem[*address] & 0b01111111;
-				} 
-				else 
-				{  
-					*address += mem[*address] & 0b01111111;
-				}
-				if (testing_mode > 1) {
-					printf("Branched to: %06x\n", *address);
-				}
-				data -> cyclenum += 1;
-			} else {
-				if (testing_mode > 1) {
-					printf("Failed to branch. Now at address:%06x\n", *address);
-				}
-			}
-			data -> cyclenum += 4;
-			break;
-		case INS_BNE_RL:
-			(*address)++;
-			if (!(data -> Z)) { 
-				//printf("Branched from: %06x\n", *address);
-				if (mem[*address] & 0b10000000) 
-				{ 
-					*address -= (mem[*address] & 0b01111111) + 1;
-				} 
-				else 
-				{  
-					*address += (mem[*address] & 0b01111111) - 1;
-				}
-				if (testing_mode > 1) {
-					printf("Branched to: %06x\n", *address);
-				}
-				data -> cyclenum += 1;
-			} else {
-				if (testing_mode > 1) {
-					printf("Failed to branch. Now at address:%06x\n", *address);
-				}
-			}
-			data -> cyclenum += 4;
-			break;
-		case INS_BPL_RL:
-			(*address)++;
-			if (!(data -> N)) { 
-				if (mem[*address] & 0b10000000) 
-				{ 
-					*address -= mem[*address] & 0b01111111;
-				} 
-				else 
-				{  
-					*address += mem[*address] & 0b01111111;
-				}
-				if (testing_mode > 1) {
-					printf("Branched to: %06x\n", *address);
-				}
-				data -> cyclenum += 1;
-			} else {
-				if (testing_mode > 1) {
-					printf("Failed to branch. Now at address:%06x\n", *address);
-				}
-			}
-			data -> cyclenum += 4;
-			break;
-		case INS_BIT_ZP:
-			(*address)++;
-			temp = data -> A & mem[mem[*address]];
-			data -> V = (temp & 0b01000000) > 0;
-			data -> N = (temp & 0b10000000) > 0;
-			data -> Z = (temp == 0);
-			data -> cyclenum += 3;
-			break;
-		case INS_BIT_AB:
-			(*address)++;
-			temp = data -> A & mem[getAddr(data, address, mem)];
-			data -> V = (temp & 0b01000000) > 0;
-			data -> N = (temp & 0b10000000) > 0;
-			data -> Z = (temp == 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_ADC_IM:
-			(*address)++;
-			uint16_t output = data -> A + mem[*address];
-			if (data -> C == 1) { output += 256; }
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 2;
-			break;
-		case INS_ADC_ZP:
-			(*address)++;
-			output = data -> A + mem[mem[*address]];
-			if (data -> C == 1) { output += 256; }
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 3;
-			break;
-		case INS_ADC_ZX:
-			(*address)++;
-			output = data -> A + (uint8_t) (mem[mem[*address] + data -> X]);
-			if (data -> C == 1) { output += 256; }
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 4;
-			break;
-		case INS_ADC_AB:
-			(*address)++;
-			output = data -> A + mem[getAddr(data, address, mem)];
-			if (data -> C == 1) { output += 256; }
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 4;
-			break;
-		case INS_ADC_AX:
-			(*address)++;
-			output = data -> A + mem[getAddr(data, address, mem) + data -> X];
-			if (data -> C == 1) { output += 256; }
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 5;
-			break;
-		case INS_ADC_AY:
-			(*address)++;
-			output = data -> A + mem[getAddr(data, address, mem)] + data -> Y;
-			if (data -> C == 1) { output += 256; }
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 5;
-			break;
-		case INS_ADC_IX:
-			(*address)++;
-			temp = (data -> X + mem[*address]) & 0b11111111;
-			output = data -> A + mem[getAddr(data, &temp, mem)];
-			if (data -> C == 1) { output += 256; }
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 6;
-			break;
-		case INS_ADC_IY:
-			(*address)++;
-			temp = mem[*address];
-			output = data -> A + mem[(getAddr(data, &temp, mem) + data -> Y) & 0b11111111];
-			if (data -> C == 1) { output += 256; }
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 6;
-			break;
-		case INS_SBC_IM:
-			(*address)++;
-			output = (data -> A - (!(data -> C) * 256)) - mem[*address];
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 2;
-			break;
-		case INS_SBC_ZP:
-			(*address)++;
-			output = (data -> A + (!(data -> C) * 256)) - mem[mem[*address]];
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 3;
-			break;
-		case INS_SBC_ZX:
-			(*address)++;
-			output = (data -> A + (!(data -> C) * 256)) - (uint8_t) (mem[mem[*address] + data -> X]);
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 4;
-			break;
-		case INS_SBC_AB:
-			(*address)++;
-			output = (data -> A + (!(data -> C) * 256)) - mem[getAddr(data, address, mem)];
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 4;
-			break;
-		case INS_SBC_AX:
-			(*address)++;
-			output = (data -> A + (!(data -> C) * 256)) - mem[getAddr(data, address, mem)+ data -> X];
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 5;
-			break;
-		case INS_SBC_AY:
-			(*address)++;
-			output = (data -> A + (!(data -> C) * 256)) - mem[getAddr(data, address, mem) + data -> Y];
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 5;
-			break;
-		case INS_SBC_IX:
-			(*address)++;
-			temp = (data -> X + mem[*address]) & 0b11111111;
-			output = (data -> A + (!(data -> C) * 256)) - mem[getAddr(data, &temp, mem)];
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 6;
-			break;
-		case INS_SBC_IY:
-			(*address)++;
-			temp = mem[*address];
-			output = (data -> A + (!(data -> C) * 256)) - mem[(getAddr(data, &temp, mem) + data -> Y) & 0b11111111];
-			data -> C = (output >= 256);
-			data -> V = ((data -> A & 0b10000000) != (output & 0b10000000));
-			data -> A = output;
-			data -> N = (data -> A & 0b10000000 > 1);
-			data -> Z = (data -> A == 0);
-			if (testing_mode > 1) {
-				printf("accumulator: %02x\n", data -> A);
-			}
-			data -> cyclenum += 6;
-			break;
-		case INS_JMP_AB:
-			(*address)++;
-			*address = getAddr(data, address, mem) - 1;
-			if (testing_mode > 1) {
-				printf("Address jumped to: %06x\n", (*address) + 1);
-			}
-			data -> cyclenum += 3;
-			break;
-		case INS_JMP_ID:
-			(*address)++;
-			uint32_t addr = getAddr(data, address, mem);
-			if (testing_mode > 1) {
-				printf("Address of address: %06x\n", addr);
-			}
-			(*address) = getAddr(data, &addr, mem) - 1;
-			if (testing_mode > 1) {
-				printf("Address jumped to: %06x\n", (*address) + 1);
-			}
-			data -> cyclenum += 5;
-			break;
-		case INS_JSR_AB:
-			(*address)++;
-			stackPush(data, mem, (*address) - 1, testing_mode);
-			stackPush(data, mem, ((*address) - 1) >> 8, testing_mode);
-			stackPush(data, mem, ((*address) - 1) >> 16, testing_mode);
-			*address = getAddr(data, address, mem) - 1;
-			if (testing_mode > 1) {
-				printf("Address jumped to: %06x\n", *address + 1);
-			}
-			data -> cyclenum += 6;
-			break;
-		case INS_RTS_IP:
-			uint8_t highHighByte = stackPop(data, mem, testing_mode);
-			uint8_t highByte = stackPop(data, mem, testing_mode);
-			uint8_t lowByte = stackPop(data, mem, testing_mode);
-			(*address) = (lowByte | ((highByte << 8) | (highHighByte << 16))) + 3;
-			if (testing_mode > 3) {
-				printf("Low address byte: %02x\n", lowByte);
-				printf("High address byte: %02x\n", highByte);
-				printf("High high address byte: %02x\n", highHighByte);
-			}
-			if (testing_mode > 1) {
-				printf("Address returned to: %06x\n", *address + 1);
-			}
-			data -> cyclenum += 6;
-			break;
-		case INS_LDX_IM:
-			(*address)++;
-			data -> X = mem[*address];
-			data -> Z = (data -> X == 0);
-			data -> N = ((data -> X & 0b10000000) > 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_LDX_ZP:
-			(*address)++;
-			data -> X = mem[mem[*address]];
-			data -> Z = (data -> X == 0);
-			data -> N = ((data -> X & 0b10000000) > 0);
-			data -> cyclenum += 3;
-			break;
-		case INS_LDX_ZY:
-			(*address)++;
-			data -> X = mem[mem[(*address + data -> Y) & 0b11111111]];
-			data -> Z = (data -> X == 0);
-			data -> cyclenum += 4;
-			data -> N = ((data -> X & 0b10000000) > 0);
-			break;
-		case INS_LDX_AB:
-			(*address)++;
-			data -> X = mem[getAddr(data, address, mem)];
-			data -> Z = (data -> X == 0);
-			data -> N = ((data -> X & 0b10000000) > 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_LDX_AY:
-			(*address)++;
-			data -> X = mem[getAddr(data, address, mem) + data -> Y];
-			data -> Z = (data -> X == 0);
-			data -> N = ((data -> X & 0b10000000) > 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_LDY_IM:
-			(*address)++;
-			data -> Y = mem[*address];
-			data -> Z = (data -> Y == 0);
-			data -> N = ((data -> Y & 0b10000000) > 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_LDY_ZP:
-			(*address)++;
-			data -> Y = mem[mem[*address]];
-			data -> Z = (data -> Y == 0);
-			data -> N = ((data -> Y & 0b10000000) > 0);
-			data -> cyclenum += 3;
-			break;
-		case INS_LDY_ZX:
-			(*address)++;
-			data -> Y = mem[mem[(*address + data -> X) & 0b11111111]];
-			data -> Z = (data -> Y == 0);
-			data -> N = ((data -> Y & 0b10000000) > 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_LDY_AB:
-			(*address)++;
-			data -> Y = mem[getAddr(data, address, mem)];
-			data -> Z = (data -> Y == 0);
-			data -> N = ((data -> Y & 0b10000000) > 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_LDY_AX:
-			(*address)++;
-			data -> Y = mem[getAddr(data, address, mem) + data -> X];
-			data -> Z = (data -> Y == 0);
-			data -> N = ((data -> Y & 0b10000000) > 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_LDA_IM:
-			(*address)++;
-			data -> A = mem[*address];
-			data -> Z = (data -> A == 0);
-			data -> N = ((data -> A & 0b10000000) > 0);
-			data -> cyclenum += 2;
-			break;
-		case INS_LDA_ZP:
-			(*address)++;
-			data -> A = mem[mem[*address]];
-			data -> Z = (data -> A == 0);
-			data -> N = ((data -> A & 0b10000000) > 0);
-			data -> cyclenum += 3;
-			break;
-		case INS_LDA_ZX:
-			(*address)++;
-			data -> A = mem[(mem[*address] + data -> X) & 0b11111111];
-			data -> Z = (data -> A == 0);
-			data -> N = ((data -> A & 0b10000000) > 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_LDA_AB:
-			(*address)++;
-			data -> A = mem[getAddr(data, address, mem)];
-			data -> Z = (data -> A == 0);
-			data -> N = ((data -> A & 0b10000000) > 0);
-			data -> cyclenum += 4;
-			break;
-		case INS_LDA_AX:
-			(*address)++;
-			temp = getAddr(data, address, mem) + data -> X;
-			data -> A = mem[temp];
-			//printf("X:%02x\n", data -> X);
-			//printf("A:%02x\n", mem[temp]);
-			//printf("A - 1:%02x\n", mem[temp - 1]);
-			//printf("A - 2:%02x\n", mem[temp - 2]);
-			//printf("A + 1:%02x\n", mem[temp + 1]);
-			//printf("A + 2:%02x\n", mem[temp + 2]);
-			data -> Z = (data -> A == 0);
-			data -> N = ((data -> A & 0b10000000) > 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_LDA_AY:
-			(*address)++;
-			data -> A = mem[getAddr(data, address, mem) + data -> Y];
-			data -> Z = (data -> A == 0);
-			data -> N = ((data -> A & 0b10000000) > 0);
-			data -> cyclenum += 5;
-			break;
-		case INS_LDA_IX:
-			(*address)++;
-			temp = mem[(mem[*address] + data -> X) & 0b11111111];
-			data -> A = mem[getAddr(data, &temp, mem)];
-			data -> Z = (data -> A == 0);
-			data -> N = ((data -> A & 0b10000000) > 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_LDA_IY:
-			(*address)++;
-			temp = mem[*address];
-			//printf("addr addr: %02x\n", temp);
-			temp = getAddr(data, &temp, mem) + data -> Y;
-			//printf("addr: %06x\n", temp);
-			//printf("val: %02x\n", mem[temp]);
-			data -> A = mem[temp];
-			data -> Z = (data -> A == 0);
-			data -> N = ((data -> A & 0b10000000) > 0);
-			data -> cyclenum += 6;
-			break;
-		case INS_CLD_IP:
-			data -> D = 0;
-			data -> cyclenum += 2;
-			break;
-		case INS_SED_IP:
-			data -> D = 1;
-			data -> cyclenum += 2;
-			break;
-		case INS_CLC_IP:
-			data -> C = 0;
-			data -> cyclenum += 2;
-			break;
-		case INS_SEC_IP:
-			data -> C = 1;
-			data -> cyclenum += 2;
-			break;
-		case INS_CLI_IP:
-			data -> I = 0;
-			data -> cyclenum += 2;
-			break;
-		case INS_SEI_IP:
-			data -> I = 1;
-			data -> cyclenum += 2;
-			break;
-		case INS_CLV_IP:
-			data -> V = 0;
-			data -> cyclenum += 2;
-			break;
-		case INS_NOP_IP:
-			data -> cyclenum += 2;
-			break;
-		default:
-			printf("Unrecognised instruction %02x at address: %06x\n", mem[*address], *address);
+
+#define EXECUTE_EPILOGUE \
+	if (testing_mode > 3) { \
+		printf("C: %d Z: %d I: %d D: %d B: %d clk: %d V: %d N: %d\n", GET_C(data), GET_Z(data), data -> I, data -> D, data -> B, data -> clk, GET_V(data), GET_N(data)); \
+		printf("PC: %06x\n", data -> PC); \
+		printf("A: %02x\n", data -> A); \
+		printf("X: %02x\n", data -> X); \
+		printf("Y: %02x\n", data -> Y); \
+		printf("SP: %02x\n", data -> SP); \
 	}
-	if (testing_mode > 3) {
-		printf("C: %d Z: %d I: %d D: %d B: %d clk: %d V: %d N: %d\n", data -> C, data -> Z, data -> I, data -> D, data -> B, data -> clk, data -> V, data -> N);
-		printf("PC: %06x\n", data -> PC);
-		printf("A: %02x\n", data -> A);
-		printf("X: %02x\n", data -> X);
-		printf("Y: %02x\n", data -> Y);
-		printf("SP: %02x\n", data -> SP);
+
+// Sticks two things together after expanding them (for making names like execute_0)
+#define PASTE2(a, b) a##b
+#define PASTE(a, b) PASTE2(a, b)
+
+/*
+The switch gets built twice from execute.c: execute_0() for testing mode 0, where
+testing_mode is a constant so the compiler throws away every debug check, and
+execute_traced() for the rest, which checks it as it goes like it always did.
+*/
+#define VARIANT 0
+#define TESTING_MODE 0
+#include "execute.c"
+#undef VARIANT
+#undef TESTING_MODE
+#define VARIANT traced
+#define TESTING_MODE level
+#include "execute.c"
+#undef VARIANT
+#undef TESTING_MODE
+
+// Hosts that care about speed should use a machine instead, which picks one of these once.
+void execute(struct data *data, uint8_t *mem, uint32_t *address, uint8_t testing_mode, uint8_t *keyboard_addr) {
+	if (testing_mode == 0) {
+		execute_0(data, mem, address, 0, keyboard_addr);
+	} else {
+		execute_traced(data, mem, address, testing_mode, keyboard_addr);
 	}
-	(*address)++;
 	return;
-}
\ No newline at end of file
+}
@@ -17,9 +17,28 @@ Helpful video: https://www.youtube.com/watch?v=qJgsuQoy9bc
 
 #include <stdint.h>
 #include "cpu6502.c"
+#include "machine.c"
+#include "memory.c"
+#include "fork.c"
+#include "image.c"
+#include "save.c"
+#include "bus.c"
+#include "interrupts.c"
+#include "events.c"
+#include "keyboard.c"
+#include "screen.c"
+#include "timer.c"
+#include "snapshot.c"
+#include "predecode.c"
+#include "idle.c"
+#include "dispatch.c"
 
 struct data;
 
+struct machine;
+
+struct aot_program;
+
 uint8_t getPS(struct data data);
 
 void setPS(struct data *data, uint8_t PS);
@@ -40,6 +59,112 @@ void save(uint8_t *mem, FILE *fptr, uint32_t *range);
 
 uint8_t* initialise_mem(struct data data, uint8_t* mem);
 
+uint8_t *make_mem(void);
+
+void free_mem(uint8_t *mem);
+
+uint8_t page_is_zero(const uint8_t *page);
+
+uint8_t write_rom(uint8_t *mem, const char *path, uint32_t start, uint32_t end);
+
+uint8_t map_rom(uint8_t *mem, const char *path, uint32_t start);
+
+uint8_t fork_machine(struct machine *parent, struct machine *child);
+
+uint8_t is_dirty(struct machine *m, uint32_t address);
+
+uint32_t next_dirty(struct machine *m, uint32_t address);
+
+void clear_dirty(struct machine *m);
+
+void save_dirty(struct machine *m, FILE *fptr, uint32_t *range);
+
+uint8_t write_image(uint8_t *mem, const char *path);
+
+uint8_t load_image(uint8_t *mem, const char *path);
+
+uint8_t save_prog(uint8_t *mem);
+
+uint8_t start_save(struct machine *m);
+
+uint8_t save_status(struct machine *m);
+
+uint8_t wait_save(struct machine *m);
+
 void reset(struct data *data, uint8_t *mem);
 
-void execute(struct data *data, uint8_t *mem, uint32_t *address, uint8_t testing_mode, uint8_t *keyboard_addr);
\ No newline at end of file
+void execute(struct data *data, uint8_t *mem, uint32_t *address, uint8_t testing_mode, uint8_t *keyboard_addr);
+
+void init_machine(struct machine *m, uint8_t *mem, uint8_t testing_mode, uint8_t engine, uint8_t *keyboard_addr);
+
+void free_machine(struct machine *m);
+
+uint64_t cycles_run(struct machine *m);
+
+uint64_t instructions_run(struct machine *m);
+
+void watch_io(struct machine *m, uint32_t address);
+
+uint8_t add_breakpoint(struct machine *m, uint32_t address);
+
+void remove_breakpoint(struct machine *m, uint32_t address);
+
+void bytes_written(struct machine *m, uint32_t address, uint32_t length);
+
+uint8_t add_device(struct machine *m, uint32_t start, uint32_t end,
+	uint8_t (*read)(struct machine *m, void *ctx, uint32_t address),
+	void (*write)(struct machine *m, void *ctx, uint32_t address, uint8_t value), void *ctx);
+
+uint8_t device_state(struct machine *m, uint32_t start, void *state, uint32_t size);
+
+uint8_t write_snapshot(struct machine *m, const char *path, uint32_t flags);
+
+void raise_irq(struct machine *m, uint8_t source);
+
+void lower_irq(struct machine *m, uint8_t source);
+
+void raise_nmi(struct machine *m);
+
+void set_irq_mask(struct machine *m, uint32_t mask);
+
+const struct irq_stats *interrupt_stats(struct machine *m, uint8_t source);
+
+uint8_t add_interrupt_controller(struct machine *m, struct interrupt_controller *controller, uint32_t start);
+
+uint8_t schedule_event(struct machine *m, uint64_t cycle, void (*fire)(struct machine *m, void *ctx, uint64_t cycle), void *ctx);
+
+void cancel_events(struct machine *m, void (*fire)(struct machine *m, void *ctx, uint64_t cycle), void *ctx);
+
+uint8_t add_keyboard(struct machine *m, struct keyboard *keyboard, uint32_t start, int fd, uint8_t source);
+
+uint8_t wait_keyboard(struct keyboard *keyboard);
+
+void free_keyboard(struct keyboard *keyboard);
+
+uint8_t add_screen(struct machine *m, struct screen *screen, uint32_t start, int fd);
+
+void screen_output(struct screen *screen, const char *text, uint32_t length);
+
+void flush_screen(struct screen *screen);
+
+void tick_screen(struct screen *screen);
+
+void screen_capture(struct screen *screen, uint8_t on);
+
+const char *screen_captured(struct screen *screen, size_t *length);
+
+void free_screen(struct screen *screen);
+
+uint8_t add_timer(struct machine *m, struct timer *timer, uint32_t start, uint8_t source);
+
+void resume_timer(struct timer *timer);
+
+uint8_t load_snapshot(struct machine *m, const char *path);
+
+uint8_t run_for(struct machine *m, uint32_t cycles);
+
+uint8_t run_steps(struct machine *m, uint32_t count);
+
+uint8_t run_until(struct machine *m, uint8_t (*condition)(struct machine *m, void *ctx), void *ctx);
+
+void use_aot(struct machine *m, const struct aot_program *program);
\ No newline at end of file
@@ -0,0 +1,299 @@
+/*******************************************************
+
+Ways of running lots of instructions in one go.
+
+execute() does one instruction per call through one big
+switch. That's simple, but every instruction pays for a
+function call plus the same (badly predicted) indirect
+jump at the top of the switch. So there are a few engines:
+
+ENGINE_SWITCH: runs execute()'s switch in a loop. This
+is the reference, if the others disagree with it they're
+wrong.
+
+ENGINE_THREADED: has a table of 256 labels (one per
+opcode) and jumps straight from the end of one
+instruction to the body of the next one with a computed
+goto, so every opcode gets its own jump and the branch
+predictor can actually learn something. It also keeps
+every instruction it runs decoded (see predecode.c), so
+it doesn't have to read the operands back out of memory
+every time, and skips over loops that are just waiting
+for memory to change (see idle.c). Needs GCC or clang,
+otherwise it just uses the switch.
+
+ENGINE_JIT: compiles the program to x86-64 code (see
+jit.c), falling back on the threaded engine for anything
+it can't do.
+
+ENGINE_AOT: runs a program that's been translated to C
+ahead of time (see aot.c and translate.c), falling back
+on the threaded engine for anything that wasn't.
+
+ENGINE_CHECKED: runs the threaded engine on the real
+machine and the switch on a copy of it, one instruction
+at a time, and stops the machine as soon as they
+disagree. Slow, only for testing.
+
+All of them use the same instruction bodies
+(instruction_bodies.c), so they can only really disagree
+on the dispatching part.
+
+The host runs a machine with run_for() (a cycle budget),
+run_steps() (an instruction budget) or run_until() (a
+condition). They all stay inside the engine until the
+budget runs out, the machine turns off, the watched I/O
+address changes or a breakpoint is hit, and return why
+they stopped (STOP_... in machine.c). Devices' events
+(see events.c) get fired on the way without the host
+hearing about it.
+
+*******************************************************/
+
+#include <string.h>
+
+#define ENGINE_SWITCH 0
+#define ENGINE_THREADED 1
+#define ENGINE_CHECKED 2
+#define ENGINE_JIT 3
+#define ENGINE_AOT 4
+
+// How often (in instructions) the checked engine compares all of memory
+#define CHECKED_MEM_INTERVAL 65536
+
+// The arguments every engine takes (the cycle budget's m -> run_end, see run_machine())
+#define RUN_ARGS struct machine *m, uint32_t count, uint8_t (*condition)(struct machine *m, void *ctx), void *ctx
+
+// What the instruction bodies expect to have in scope, taken from the machine (plus testing_mode)
+#define MACHINE_LOCALS \
+	struct data *data = &m -> data; \
+	uint8_t *mem = m -> mem; \
+	uint32_t *address = &data -> PC; \
+	uint8_t *keyboard_addr = m -> keyboard_addr; \
+	uint32_t done = 0; \
+	uint8_t reason = STOP_BUDGET;
+
+/*
+Checked after every instruction. count and m -> run_end are the budgets (0 means no
+limit for count, which is sorted out at the start of run_machine() so this doesn't have
+to check). An interrupt goes in first, so the stop checks see where it went.
+*/
+#define CHECK_STOP \
+	done++; \
+	if (INTERRUPT_PENDING(m)) { \
+		take_irq(m); \
+	} \
+	if (data -> clk == 0) { \
+		reason = STOP_HALT; \
+		goto stop; \
+	} \
+	if (m -> io_watching && mem[m -> io_watch] != m -> io_last) { \
+		m -> io_last = mem[m -> io_watch]; \
+		reason = STOP_IO; \
+		goto stop; \
+	} \
+	if (m -> breakpoint_count > 0 && is_breakpoint(m, *address)) { \
+		reason = STOP_BREAKPOINT; \
+		goto stop; \
+	} \
+	if (condition != NULL && condition(m, ctx)) { \
+		reason = STOP_CONDITION; \
+		goto stop; \
+	} \
+	if (done == count || data -> cyclenum >= m -> run_end) { \
+		reason = STOP_BUDGET; \
+		goto stop; \
+	}
+
+// Testing mode 0 gets its own engines with all of the debug checks gone, like execute_0()
+#define VARIANT 0
+#define TESTING_MODE 0
+#include "threaded.c"
+#undef VARIANT
+#undef TESTING_MODE
+#define VARIANT traced
+#define TESTING_MODE (m -> testing_mode)
+#include "threaded.c"
+#undef VARIANT
+#undef TESTING_MODE
+
+#include "jit.c"
+#include "aot.c"
+
+// Returns 1 if the machine and its checked copy are in the same state
+uint8_t check_state(struct machine *m, uint8_t full) {
+	struct data *data = &m -> data;
+	struct data *checked = &m -> checked_data;
+
+	if (getPS(*data) != getPS(*checked) || data -> PC != checked -> PC || data -> SP != checked -> SP ||
+		data -> A != checked -> A || data -> X != checked -> X || data -> Y != checked -> Y ||
+		data -> cyclenum != checked -> cyclenum || data -> instructions != checked -> instructions ||
+		data -> exit_code != checked -> exit_code) {
+		printf("Threaded: PS: %02x PC: %06x SP: %02x A: %02x X: %02x Y: %02x cycles: %llu\n",
+			getPS(*data), data -> PC, data -> SP, data -> A, data -> X, data -> Y, (unsigned long long) data -> cyclenum);
+		printf("Switch:   PS: %02x PC: %06x SP: %02x A: %02x X: %02x Y: %02x cycles: %llu\n",
+			getPS(*checked), checked -> PC, checked -> SP, checked -> A, checked -> X, checked -> Y, (unsigned long long) checked -> cyclenum);
+		return 0;
+	}
+
+	if (full && memcmp(m -> mem, m -> checked_mem, MAX_MEM + 1) != 0) {
+		for (uint32_t i = 0; i <= MAX_MEM; i++) {
+			if (m -> mem[i] != m -> checked_mem[i]) {
+				printf("Memory differs at %06x (threaded: %02x switch: %02x)\n", i, m -> mem[i], m -> checked_mem[i]);
+				break;
+			}
+		}
+		return 0;
+	}
+
+	return 1;
+}
+
+uint8_t run_checked(RUN_ARGS) {
+	MACHINE_LOCALS
+	uint8_t (*run_threaded)(RUN_ARGS) = (m -> testing_mode == 0) ? run_threaded_0 : run_threaded_traced;
+
+	if (m -> checked_mem == NULL) {
+		m -> checked_mem = make_mem();
+		if (m -> checked_mem == NULL) {
+			perror("Failed to allocate memory for the checked engine");
+			return run_threaded(m, count, condition, ctx);
+		}
+		// It starts out all zeros, so only copy the pages that aren't (see memory.c)
+		for (uint32_t i = 0; i <= MAX_MEM; i += PAGE_SIZE) {
+			if (!page_is_zero(&mem[i])) {
+				memcpy(&m -> checked_mem[i], &mem[i], PAGE_SIZE);
+			}
+		}
+		m -> checked_data = *data;
+	}
+
+	while (1) {
+		uint8_t opcode = mem[*address];
+		uint32_t instruction_address = *address;
+		uint32_t irqs_taken = m -> irqs_taken;
+
+		// This does the stop checks that need to see the instruction happen (I/O, breakpoints)
+		uint8_t threaded_reason = run_threaded(m, 1, NULL, NULL);
+
+		if (opcode == MTA_KYB_IP || opcode == MTA_SAV_IP || opcode == MTA_OFS_IP) {
+			// These talk to the host (stdin and prog.txt), so only do them once and copy the result over
+			m -> checked_data = *data;
+			memcpy(&m -> checked_mem[keyboard_addr - mem], keyboard_addr, 250);
+		} else {
+			execute_0(&m -> checked_data, m -> checked_mem, &m -> checked_data.PC, 0, &m -> checked_mem[keyboard_addr - mem]);
+		}
+		if (m -> irqs_taken != irqs_taken) {
+			// execute() doesn't know about interrupts, so the copy gets the threaded engine's
+			m -> checked_data = *data;
+			memcpy(&m -> checked_mem[STACK_RANGE[0]], &mem[STACK_RANGE[0]], STACK_RANGE[1] - STACK_RANGE[0] + 1);
+		}
+
+		m -> checked_since_mem++;
+		uint8_t full = (m -> checked_since_mem >= CHECKED_MEM_INTERVAL || data -> clk == 0);
+		if (full) {
+			m -> checked_since_mem = 0;
+		}
+		if (!check_state(m, full)) {
+			printf("Engines disagree after instruction %02x at address: %06x\n", opcode, instruction_address);
+			data -> clk = 0;
+			return STOP_MISMATCH;
+		}
+
+		if (threaded_reason != STOP_BUDGET) {
+			return threaded_reason;
+		}
+		// The threaded engine already checked everything else, this is just for the budgets
+		done++;
+		if (condition != NULL && condition(m, ctx)) {
+			reason = STOP_CONDITION;
+			break;
+		}
+		if (done == count || data -> cyclenum >= m -> run_end) {
+			break;
+		}
+	}
+
+	return reason;
+}
+
+// Called by init_machine() to pick the engine the machine is going to use from now on
+void pick_engine(struct machine *m) {
+	switch (m -> engine) {
+		case ENGINE_THREADED:
+			m -> run = (m -> testing_mode == 0) ? run_threaded_0 : run_threaded_traced;
+			break;
+		case ENGINE_CHECKED:
+			m -> run = run_checked;
+			break;
+		case ENGINE_JIT:
+			m -> run = run_jit;
+			break;
+		case ENGINE_AOT:
+			m -> run = run_aot;
+			break;
+		default:
+			m -> run = (m -> testing_mode == 0) ? run_switch_0 : run_switch_traced;
+			break;
+	}
+
+	return;
+}
+
+/*
+Runs the engine in stretches between events (see events.c), firing each one when it gets
+there, until one of the budgets runs out or it stops for anything else.
+*/
+uint8_t run_machine(struct machine *m, uint32_t count, uint32_t cycles, uint8_t (*condition)(struct machine *m, void *ctx), void *ctx) {
+	uint8_t reason;
+
+	if (m -> data.clk == 0) {
+		return STOP_HALT;
+	}
+	if (count == 0) {
+		count = UINT32_MAX;
+	}
+	if (cycles == 0) {
+		cycles = UINT32_MAX;
+	}
+	m -> idle_at = IDLE_NONE; // The host might have changed memory since last time
+
+	uint64_t end = m -> data.cyclenum + cycles;
+	uint64_t instructions = m -> data.instructions;
+	while (1) {
+		if (m -> data.cyclenum >= m -> next_event) {
+			run_events(m);
+		}
+		m -> run_end = (m -> next_event < end) ? m -> next_event : end;
+		if (m -> run_end <= m -> data.cyclenum) {
+			m -> run_end = m -> data.cyclenum + 1; // An event that's due right now still gets an instruction first
+		}
+
+		reason = m -> run(m, count - (uint32_t) (m -> data.instructions - instructions), condition, ctx);
+		if (reason != STOP_BUDGET || m -> data.cyclenum >= end || m -> data.instructions - instructions >= count) {
+			break;
+		}
+		m -> idle_at = IDLE_NONE; // The event might change what the loop's waiting for
+	}
+	// It's off, so there's nothing left to do while the last save finishes (and the host's probably about to exit)
+	if (reason == STOP_HALT) {
+		wait_save(m);
+	}
+
+	return reason;
+}
+
+// Runs until at least "cycles" clock cycles have gone by (or something else stops it)
+uint8_t run_for(struct machine *m, uint32_t cycles) {
+	return run_machine(m, 0, cycles == 0 ? 1 : cycles, NULL, NULL);
+}
+
+// Runs "count" instructions (or until something else stops it)
+uint8_t run_steps(struct machine *m, uint32_t count) {
+	return run_machine(m, count == 0 ? 1 : count, 0, NULL, NULL);
+}
+
+// Runs until condition() returns non zero (or something else stops it)
+uint8_t run_until(struct machine *m, uint8_t (*condition)(struct machine *m, void *ctx), void *ctx) {
+	return run_machine(m, 0, 0, condition, ctx);
+}
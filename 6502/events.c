@@ -0,0 +1,134 @@
+/*******************************************************
+
+Events: devices doing things at a certain cycle.
+
+Devices used to only get to do anything when the program
+touched their registers or when the host got control
+back between runs, so anything that's meant to happen
+after a while (a timer going off) either happened
+whenever the host next looked, or every device had to
+check the cycle count after every instruction. Now a
+device can schedule_event() for the cycle it wants, and
+fire() gets called at that cycle, between instructions,
+with the engine running flat out until then.
+
+The events are a min-heap on their cycle, so the next one
+is always events[0], and m -> next_event has its cycle.
+run_machine() (see dispatch.c) never lets an engine run
+past that: it sets m -> run_end to whichever comes first,
+the end of the budget or the next event, and that's the
+only cycle check the engines do, so it's no slower than
+the budget check was on its own. When the engine stops
+there the event gets fired and the engine carries on from
+where it was. Scheduling an event from inside a run
+(a device's write()) pulls run_end in if it has to.
+
+An event goes off at the end of the first instruction
+that gets to its cycle, so it can be a few cycles late
+(and the JIT and AOT only look at the end of a block).
+Skipping idle loops (see idle.c) only skips up to the
+next one.
+
+fire() gets the cycle it was scheduled for, rather than
+the one it actually went off on, so a device doing
+something every so often can schedule the next one from
+that and never drift. Events are the host's, like the
+devices, so they don't go in snapshots or forked
+machines, and only the thread running the machine can
+schedule them (unlike raise_irq()). Like anything else the
+host does to memory, ENGINE_CHECKED's copy doesn't see
+what fire() writes there.
+
+*******************************************************/
+
+/*
+Calls fire(m, ctx, cycle) at cycle (or as soon after as the engine gets to, if it's already
+gone by). Returns 0 if there are already MAX_EVENTS waiting.
+*/
+uint8_t schedule_event(struct machine *m, uint64_t cycle, void (*fire)(struct machine *m, void *ctx, uint64_t cycle), void *ctx) {
+	uint32_t i;
+
+	if (m -> event_count >= MAX_EVENTS) {
+		return 0;
+	}
+
+	// Up the heap from the bottom until its parent's sooner
+	i = m -> event_count;
+	m -> event_count++;
+	while (i > 0 && m -> events[(i - 1) / 2].cycle > cycle) {
+		m -> events[i] = m -> events[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	m -> events[i].cycle = cycle;
+	m -> events[i].fire = fire;
+	m -> events[i].ctx = ctx;
+
+	m -> next_event = m -> events[0].cycle;
+	// If it's running, it has to stop in time for it
+	if (cycle < m -> run_end) {
+		m -> run_end = cycle;
+	}
+
+	return 1;
+}
+
+// Puts the event at i down the heap until its children are later
+void sift_event(struct machine *m, uint32_t i) {
+	struct event event = m -> events[i];
+
+	while (2 * i + 1 < m -> event_count) {
+		uint32_t child = 2 * i + 1;
+		if (child + 1 < m -> event_count && m -> events[child + 1].cycle < m -> events[child].cycle) {
+			child++;
+		}
+		if (m -> events[child].cycle >= event.cycle) {
+			break;
+		}
+		m -> events[i] = m -> events[child];
+		i = child;
+	}
+	m -> events[i] = event;
+
+	return;
+}
+
+// Takes out every event with this fire() and ctx that hasn't gone off yet
+void cancel_events(struct machine *m, void (*fire)(struct machine *m, void *ctx, uint64_t cycle), void *ctx) {
+	uint32_t kept = 0;
+
+	for (uint32_t i = 0; i < m -> event_count; i++) {
+		if (m -> events[i].fire != fire || m -> events[i].ctx != ctx) {
+			m -> events[kept] = m -> events[i];
+			kept++;
+		}
+	}
+	if (kept == m -> event_count) {
+		return;
+	}
+	m -> event_count = kept;
+	// Taking things out of the middle breaks the heap, so make it again
+	for (uint32_t i = kept / 2; i-- > 0;) {
+		sift_event(m, i);
+	}
+	m -> next_event = (kept > 0) ? m -> events[0].cycle : UINT64_MAX;
+
+	return;
+}
+
+// Fires everything that's due by now, in order (including anything they schedule that's due too)
+void run_events(struct machine *m) {
+	while (m -> event_count > 0 && m -> events[0].cycle <= m -> data.cyclenum) {
+		struct event event = m -> events[0];
+
+		m -> event_count--;
+		if (m -> event_count > 0) {
+			m -> events[0] = m -> events[m -> event_count];
+			sift_event(m, 0);
+		}
+		m -> next_event = (m -> event_count > 0) ? m -> events[0].cycle : UINT64_MAX;
+
+		event.fire(m, event.ctx, event.cycle);
+	}
+
+	return;
+}
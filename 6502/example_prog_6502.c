@@ -18,32 +18,46 @@ int main() {
 	// 2 is more (e.g printing addresses jumped to), 3 is most (e.g printing values 
 	// pushed to/pulled from the stack), 4 is everything (e.g printing the registers)
 	uint8_t testing_mode = 4;
+
+	// Set the engine: ENGINE_SWITCH is the plain switch in execute(), ENGINE_THREADED
+	// is faster, ENGINE_CHECKED runs both and stops if they ever disagree (slow)
+	uint8_t engine = ENGINE_THREADED;
 	
-	// Make the data struct that contains all of the register info
-	struct data data;
-	data.clk = 0;
-	data.cyclenum = 0;
+	// Make the memory (16 megs wow! It only really uses what the program writes to, see memory.c)
+	uint8_t *mem = make_mem();
+	if (mem == NULL) {
+		perror("Failed to allocate memory");
+		return 1;
+	}
 
-	// Make the memory
-	uint8_t *mem = (uint8_t*) malloc(1024 * 1024 * 16); // 16 megs wow!
+	// Make the machine (the data struct that contains all of the register info, the
+	// memory and the settings)
+	struct machine m;
+	init_machine(&m, mem, testing_mode, engine, &mem[IO_RANGE[0]]);
 
 	// This is just so the program is out of the way and it's easier to navigate main.
 	loadProg(mem);
 
 	/* 
-	Initialise the memory (zero the drive) and data (Setting the clock cycles to 
-	0, activating it, etc). Note: It is important to load the program before resetting 
-	data, as it will look for a vector at 0xFFFC and 0xFFFD.
+	Initialise the data (Setting the clock cycles to 0, activating it, etc). Note: It 
+	is important to load the program before resetting data, as it will look for a 
+	vector at 0xFFFC and 0xFFFD.
 	*/
-	initialise_mem(data, mem);
-	reset(&data, mem);
+	reset(&m.data, mem);
+	watch_io(&m, IO_RANGE[1]);
 
 	// Execute the program
 	int alreadyPrinted = 0;
 	int nextFree = 0;
 	char string[IO_RANGE[1] - IO_RANGE[0]];
-	while (data.clk == 1) {
-		execute(&data, mem, &data.PC, testing_mode, &mem[IO_RANGE[0]]);
+	while (m.data.clk == 1) {
+		// Run until the screen's control byte changes (or every instruction when debugging,
+		// so the debug info below still comes out after each one)
+		if (testing_mode > 0) {
+			run_steps(&m, 1);
+		} else {
+			run_for(&m, 1000000);
+		}
 		// Custom screen component
 		if (mem[IO_RANGE[1]]) {
 			if (alreadyPrinted == 0) {
@@ -58,7 +72,7 @@ int main() {
 			alreadyPrinted = 0;
             if (testing_mode > 2) 
             {
-                printf("Addr cleared: %06x\n", data.PC);
+                printf("Addr cleared: %06x\n", m.data.PC);
             }
 		}
         if (testing_mode > 3) 
@@ -72,8 +86,9 @@ int main() {
 	}
 
 	// Print some debug info
-	printf("Clock cycles: %d\n", data.cyclenum);
-	printf("Final address: %06x\n", (data.PC - 1) & 0xFFFF);
+	printf("Clock cycles: %llu\n", (unsigned long long) cycles_run(&m));
+	printf("Instructions: %llu\n", (unsigned long long) instructions_run(&m));
+	printf("Final address: %06x\n", (m.data.PC - 1) & 0xFFFF);
 
 	// Output onto the terminal
 	printf("TERMINAL OUTPUT:\n");
@@ -84,9 +99,10 @@ int main() {
         printf("%02x ", string[i]);
     }
 
-	free(mem);
+	free_machine(&m);
+	free_mem(mem);
 
-	return data.exit_code;
+	return m.data.exit_code;
 }
 
 void loadProg(uint8_t *mem) {
@@ -0,0 +1,45 @@
+/*
+The switch, as execute_<VARIANT>(). cpu6502.c includes this once for every variant,
+with TESTING_MODE set to where testing_mode comes from (a constant, or "level").
+*/
+
+void PASTE(execute_, VARIANT)(struct data *data, uint8_t *mem, uint32_t *address, uint8_t level, uint8_t *keyboard_addr) {
+	const uint8_t testing_mode = TESTING_MODE;
+	INSTRUCTION_LOCALS
+	EXECUTE_PROLOGUE
+	switch (mem[*address]) {
+#define OP(opcode) case opcode: data -> cyclenum += instruction_cycles[opcode];
+#define END_OP break;
+#define OP_BAIL return
+#define OPERAND_BYTE mem[*address]
+#define OPERAND_ABS getAddr(data, address, mem)
+#define LOAD(a) mem[a]
+#define STORE(a, v) mem[a] = (v)
+#define WROTE(a, length)
+#define PUSH(v) stackPush(data, mem, v, testing_mode)
+#define POP() stackPop(data, mem, testing_mode)
+#define SAVE_PROG() save_prog(mem)
+#define KEYBOARD_LINE() (fgets((char*) keyboard_addr, 250, stdin), 1)
+#define WAIT_INPUT OP_BAIL
+#include "instruction_bodies.c"
+#undef OP
+#undef END_OP
+#undef OP_BAIL
+#undef OPERAND_BYTE
+#undef OPERAND_ABS
+#undef LOAD
+#undef STORE
+#undef WROTE
+#undef PUSH
+#undef POP
+#undef SAVE_PROG
+#undef KEYBOARD_LINE
+#undef WAIT_INPUT
+		default:
+			printf("Unrecognised instruction %02x at address: %06x\n", mem[*address], *address);
+	}
+	EXECUTE_EPILOGUE
+	(*address)++;
+	data -> instructions++;
+	return;
+}
@@ -0,0 +1,135 @@
+/*******************************************************
+
+Forking a machine: making a new one that carries on from
+exactly where another one is, without copying its 16MB.
+
+Booting Sigma OS and then wanting lots of machines that
+all start from there (one per test, or per input) used
+to mean a fresh copy of memory plus reset() and the whole
+boot every time. fork_machine() does it with the same
+trick as fork() does for processes: the parent's memory
+gets put in a file (only the pages that aren't all zeros,
+which is hardly any of it), the parent's memory gets
+mapped back over the top of itself from that file, and
+the child gets the same file mapped too. They're both
+private mappings, so the first time either of them writes
+to a page it gets its own copy of just that page, and
+neither of them ever sees what the other one does.
+
+Putting it in a file has to look through all of memory,
+so the first fork after the parent changes anything costs
+about as much as the pages it's using. After that the
+parent's pages are all PAGE_FORKED, and while it doesn't
+write to any of them every fork just maps the same file
+again, so forking 100 children off a machine that's
+sitting at a prompt is 1 copy and 100 mmap()s.
+
+A child gets the parent's registers, memory, testing
+mode, engine, watched I/O address, breakpoints and
+translated program. It doesn't get the devices, their
+ctx is the host's and it's up to the host whether they
+can be shared (add them again on the child).
+
+*******************************************************/
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+/*
+Puts the machine's memory in a new file and maps it back over the top of itself. Returns
+the file, or -1 if it couldn't (its memory's still there as it was, as long as the last
+bit worked).
+*/
+int share_mem(struct machine *m) {
+	int fd = -1;
+
+#ifdef SYS_memfd_create
+	// Just a file in memory, it's the same as tmpfile() otherwise
+	fd = syscall(SYS_memfd_create, "6502 memory", 0);
+#endif
+	if (fd < 0) {
+		FILE *temp = tmpfile();
+		if (temp == NULL) {
+			return -1;
+		}
+		fd = dup(fileno(temp)); // It's gone from the disk as soon as nothing has it open
+		fclose(temp);
+		if (fd < 0) {
+			return -1;
+		}
+	}
+
+	if (ftruncate(fd, MEM_SIZE) != 0) {
+		close(fd);
+		return -1;
+	}
+	// The file starts out all zeros too, so only the other pages need writing
+	for (uint32_t i = 0; i < MEM_SIZE; i += PAGE_SIZE) {
+		if (!page_is_zero(&m -> mem[i]) && pwrite(fd, &m -> mem[i], PAGE_SIZE, i) != PAGE_SIZE) {
+			close(fd);
+			return -1;
+		}
+	}
+	if (mmap(m -> mem, MEM_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		close(fd);
+		return -1;
+	}
+
+	for (uint32_t i = 0; i <= PAGE_COUNT; i++) {
+		m -> page_flags[i] |= PAGE_FORKED;
+	}
+	m -> fork_fd = fd;
+
+	return fd;
+}
+
+// Called the first time the machine writes to memory after forking, the next fork needs a new file
+void fork_written(struct machine *m) {
+	for (uint32_t i = 0; i <= PAGE_COUNT; i++) {
+		m -> page_flags[i] &= ~PAGE_FORKED;
+	}
+	close(m -> fork_fd);
+	m -> fork_fd = -1;
+
+	return;
+}
+
+/*
+Makes child a new machine that carries on from where parent is (parent's memory has to
+come from make_mem()). Give child's memory back with free_mem(child.mem) after
+free_machine(). Returns 0 if it couldn't, child isn't set up then.
+*/
+uint8_t fork_machine(struct machine *parent, struct machine *child) {
+#ifdef MAP_ANONYMOUS
+	if ((uintptr_t) parent -> mem % sysconf(_SC_PAGESIZE) != 0) {
+		return 0;
+	}
+	if (parent -> fork_fd < 0 && share_mem(parent) < 0) {
+		return 0;
+	}
+
+	void *shared = mmap(NULL, MEM_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE, parent -> fork_fd, 0);
+	if (shared == MAP_FAILED) {
+		return 0;
+	}
+	uint8_t *mem = (uint8_t*) shared;
+
+	init_machine(child, mem, parent -> testing_mode, parent -> engine, &mem[parent -> keyboard_addr - parent -> mem]);
+	child -> data = parent -> data;
+	if (parent -> io_watching) {
+		watch_io(child, parent -> io_watch);
+		child -> io_last = parent -> io_last;
+	}
+	for (uint8_t i = 0; i < parent -> breakpoint_count; i++) {
+		add_breakpoint(child, parent -> breakpoints[i]);
+	}
+	if (parent -> aot != NULL) {
+		use_aot(child, parent -> aot);
+	}
+
+	return 1;
+#else
+	return 0;
+#endif
+}
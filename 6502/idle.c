@@ -0,0 +1,138 @@
+/*******************************************************
+
+Skipping idle loops, used by the threaded engine.
+
+A lot of the time a program is just sitting in a loop
+waiting for a byte to change, like "LDA key; BEQ back",
+and the whole host core goes on running the same few
+instructions over and over. If a loop doesn't write to
+anything and the registers and flags are the same every
+time it gets back to the jump at the bottom, then every
+time round is going to be exactly the same as the last
+one until something outside the loop changes memory,
+and nothing can while the engine is running. So instead
+of going round again the engine just adds on the cycles
+(and instructions) for as many times round as fit in
+what's left of the budget, and lets the rest run
+normally. Afterwards the machine is in exactly the
+state it would have been in, it just got there quicker.
+
+The decoder (predecode.c) checks every jump backwards
+when it decodes it, and only hooks up the ones at the
+bottom of a loop like that. After that the engine calls
+skip_idle() before every time the jump runs.
+
+*******************************************************/
+
+#define IDLE_MAX_LOOP 64 // The most bytes a loop can be
+
+// Instructions that don't write to memory, use the stack or talk to the host
+const uint8_t idle_safe[256] = {
+	[INS_LDA_IM] = 1, [INS_LDA_ZP] = 1, [INS_LDA_ZX] = 1, [INS_LDA_AB] = 1, [INS_LDA_AX] = 1, [INS_LDA_AY] = 1,
+	[INS_LDA_IX] = 1, [INS_LDA_IY] = 1, [INS_LDX_IM] = 1, [INS_LDX_ZP] = 1, [INS_LDX_ZY] = 1, [INS_LDX_AB] = 1,
+	[INS_LDX_AY] = 1, [INS_LDY_IM] = 1, [INS_LDY_ZP] = 1, [INS_LDY_ZX] = 1, [INS_LDY_AB] = 1, [INS_LDY_AX] = 1,
+	[INS_CMP_IM] = 1, [INS_CMP_ZP] = 1, [INS_CMP_ZX] = 1, [INS_CMP_AB] = 1, [INS_CMP_AX] = 1, [INS_CMP_AY] = 1,
+	[INS_CMP_IX] = 1, [INS_CMP_IY] = 1, [INS_CPX_IM] = 1, [INS_CPX_ZP] = 1, [INS_CPX_AB] = 1, [INS_CPY_IM] = 1,
+	[INS_CPY_ZP] = 1, [INS_CPY_AB] = 1, [INS_BIT_ZP] = 1, [INS_BIT_AB] = 1,
+	[INS_AND_IM] = 1, [INS_AND_ZP] = 1, [INS_AND_ZX] = 1, [INS_AND_AB] = 1, [INS_AND_AX] = 1, [INS_AND_AY] = 1,
+	[INS_AND_IX] = 1, [INS_AND_IY] = 1, [INS_ORA_IM] = 1, [INS_ORA_ZP] = 1, [INS_ORA_ZX] = 1, [INS_ORA_AB] = 1,
+	[INS_ORA_AX] = 1, [INS_ORA_AY] = 1, [INS_ORA_IX] = 1, [INS_ORA_IY] = 1, [INS_EOR_IM] = 1, [INS_EOR_ZP] = 1,
+	[INS_EOR_ZX] = 1, [INS_EOR_AB] = 1, [INS_EOR_AX] = 1, [INS_EOR_AY] = 1, [INS_EOR_IX] = 1, [INS_EOR_IY] = 1,
+	[INS_TAX_IP] = 1, [INS_TAY_IP] = 1, [INS_TYA_IP] = 1, [INS_TXA_IP] = 1, [INS_TSX_IP] = 1, [INS_TXS_IP] = 1,
+	[INS_INX_IP] = 1, [INS_INY_IP] = 1, [INS_DEX_IP] = 1, [INS_DEY_IP] = 1, [INS_NOP_IP] = 1,
+	[INS_CLC_IP] = 1, [INS_CLD_IP] = 1, [INS_CLI_IP] = 1, [INS_CLV_IP] = 1, [INS_SEC_IP] = 1, [INS_SED_IP] = 1,
+	[INS_SEI_IP] = 1,
+};
+
+/*
+Returns 1 if the jump at address is the bottom of a loop that can be skipped: it goes
+backwards, and everything from where it goes to up to it is safe and only ever jumps
+somewhere else in the loop, so once it's gone round it can only get back to the jump.
+*/
+uint8_t is_idle_loop(uint8_t *mem, uint32_t address) {
+	uint8_t opcode = mem[address];
+	uint32_t top, i;
+
+	if (!is_jump(opcode) || address + 3 > MAX_MEM) {
+		return 0;
+	}
+	top = branch_target(opcode, address, operand_at(mem, address, length_of(opcode)));
+	if (top > address || address - top > IDLE_MAX_LOOP) {
+		return 0;
+	}
+
+	for (i = top; i < address; i += length_of(mem[i])) {
+		opcode = mem[i];
+		if (is_jump(opcode)) {
+			uint32_t to = branch_target(opcode, i, operand_at(mem, i, length_of(opcode)));
+			if (to < top || to > address) {
+				return 0;
+			}
+		} else if (!idle_safe[opcode]) {
+			return 0;
+		}
+	}
+
+	return i == address; // Otherwise the jump's in the middle of an instruction
+}
+
+// Whether the jump at PC is going to be taken
+uint8_t jump_taken(struct data *data, uint8_t opcode) {
+	switch (opcode) {
+		case INS_BVS_RL: return GET_V(data);
+		case INS_BVC_RL: return !GET_V(data);
+		case INS_BCS_RL: return GET_C(data);
+		case INS_BCC_RL: return !GET_C(data);
+		case INS_BEQ_RL: return GET_Z(data);
+		case INS_BMI_RL: return GET_N(data);
+		case INS_BNE_RL: return !GET_Z(data);
+		case INS_BPL_RL: return !GET_N(data);
+		default: return 1;
+	}
+}
+
+/*
+Called right before the jump at the bottom of a possible idle loop runs. done and count
+are the engine's (the cycle budget is m -> run_end, which stops at the next event too),
+and it returns how many instructions it skipped.
+*/
+uint32_t skip_idle(struct machine *m, uint32_t done, uint32_t count) {
+	struct data *data = &m -> data;
+	struct data *last = &m -> idle_data;
+	uint32_t loops, loop_cycles, loop_done;
+
+	if (!jump_taken(data, m -> mem[data -> PC])) {
+		// Out of the loop, so whatever happens before it gets back here could change anything
+		m -> idle_at = IDLE_NONE;
+		return 0;
+	}
+	if (m -> idle_at != data -> PC || getPS(*data) != getPS(*last) || data -> A != last -> A ||
+		data -> X != last -> X || data -> Y != last -> Y || data -> SP != last -> SP) {
+		// Not the same as last time round (yet)
+		m -> idle_at = data -> PC;
+		m -> idle_data = *data;
+		m -> idle_done = done;
+		return 0;
+	}
+
+	// Stop just short of the budgets, the engine does the last bit so it stops in the same place
+	loop_cycles = (uint32_t) (data -> cyclenum - last -> cyclenum);
+	loop_done = done - m -> idle_done;
+	if (loop_cycles == 0 || loop_done == 0 || !is_idle_loop(m -> mem, data -> PC)) {
+		m -> idle_at = IDLE_NONE;
+		return 0;
+	}
+	if (m -> run_end <= data -> cyclenum) {
+		return 0;
+	}
+	loops = (m -> run_end - data -> cyclenum - 1) / loop_cycles;
+	if ((count - done - 1) / loop_done < loops) {
+		loops = (count - done - 1) / loop_done;
+	}
+
+	data -> cyclenum += (uint64_t) loops * loop_cycles;
+	m -> idle_data = *data;
+	m -> idle_done = done + loops * loop_done;
+
+	return loops * loop_done;
+}
@@ -0,0 +1,178 @@
+/*******************************************************
+
+Program images: a binary version of prog.txt.
+
+prog.txt is nice to write by hand, but loading it means
+reading every single byte as a line of text, which gets
+slow once there are megabytes of it. An image has the
+same things in it, just as raw bytes, so loading one is
+just reading it:
+
+	the header (everything little endian):
+		"6502"      4 bytes
+		version     4 bytes (IMAGE_VERSION)
+		segments    4 bytes, how many there are
+		reset       4 bytes, what goes at 0xFFFFFA
+		interrupt   4 bytes, what goes at 0xFFFFFD
+		checksum    4 bytes, FNV-1a of everything after the header
+	then each segment:
+		address     4 bytes
+		length      4 bytes
+		the bytes
+
+A segment is a run of memory that isn't all zeros (short
+runs of zeros in the middle don't end it, same as save()
+does with prog.txt), and the vectors get their own spot
+so the loader always knows where the program starts.
+
+Make one from a prog.txt with make_image.c:
+	gcc -o make_image make_image.c -lm -lpthread
+	./make_image prog.txt prog.img
+
+*******************************************************/
+
+#define IMAGE_VERSION 1
+#define IMAGE_HEADER_SIZE 24
+#define IMAGE_GAP 16 // How many zeros it takes to end a segment
+#define IMAGE_VECTORS 0xFFFFFA // Where the vectors are, segments stop before them
+
+#define FNV_START 2166136261u
+#define FNV_PRIME 16777619u
+
+uint32_t fnv1a(uint32_t hash, const uint8_t *bytes, uint32_t length) {
+	for (uint32_t i = 0; i < length; i++) {
+		hash = (hash ^ bytes[i]) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+void put_u32(uint8_t *bytes, uint32_t value) {
+	bytes[0] = value;
+	bytes[1] = value >> 8;
+	bytes[2] = value >> 16;
+	bytes[3] = value >> 24;
+
+	return;
+}
+
+uint32_t get_u32(const uint8_t *bytes) {
+	return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t) bytes[3] << 24);
+}
+
+/*
+Saves all of memory as an image. Like write_rom() it goes to a temporary file first and
+gets renamed over path at the end. Returns 0 if it couldn't write it.
+*/
+uint8_t write_image(uint8_t *mem, const char *path) {
+	char temp_path[300];
+	uint8_t header[IMAGE_HEADER_SIZE];
+	uint8_t segment_header[8];
+	uint32_t segments = 0;
+	uint32_t checksum = FNV_START;
+
+	FILE *fptr = open_temp(path, temp_path, sizeof(temp_path));
+	if (fptr == NULL) {
+		return 0;
+	}
+	fseek(fptr, IMAGE_HEADER_SIZE, SEEK_SET); // The header goes in at the end once everything's counted
+
+	uint32_t address = 0;
+	while (address < IMAGE_VECTORS) {
+		// Most of it's empty pages, skip those whole
+		if ((address & PAGE_MASK) == 0 && page_is_zero(&mem[address])) {
+			address += PAGE_SIZE;
+			continue;
+		}
+		if (mem[address] == 0) {
+			address++;
+			continue;
+		}
+
+		// Found one, it goes until there are IMAGE_GAP zeros in a row (or the vectors)
+		uint32_t start = address;
+		uint32_t end = address; // The last byte that isn't 0
+		while (address < IMAGE_VECTORS && address - end <= IMAGE_GAP) {
+			if (mem[address] != 0) {
+				end = address;
+			}
+			address++;
+		}
+
+		put_u32(&segment_header[0], start);
+		put_u32(&segment_header[4], end - start + 1);
+		fwrite(segment_header, 1, sizeof(segment_header), fptr);
+		fwrite(&mem[start], 1, end - start + 1, fptr);
+		checksum = fnv1a(checksum, segment_header, sizeof(segment_header));
+		checksum = fnv1a(checksum, &mem[start], end - start + 1);
+		segments++;
+	}
+
+	memcpy(header, "6502", 4);
+	put_u32(&header[4], IMAGE_VERSION);
+	put_u32(&header[8], segments);
+	put_u32(&header[12], mem[0xFFFFFA] | (mem[0xFFFFFB] << 8) | (mem[0xFFFFFC] << 16));
+	put_u32(&header[16], mem[0xFFFFFD] | (mem[0xFFFFFE] << 8) | (mem[0xFFFFFF] << 16));
+	put_u32(&header[20], checksum);
+	fseek(fptr, 0, SEEK_SET);
+	fwrite(header, 1, sizeof(header), fptr);
+
+	uint8_t failed = ferror(fptr);
+	failed |= (fclose(fptr) != 0);
+	if (failed || rename(temp_path, path) != 0) {
+		remove(temp_path);
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+Loads an image into memory (which should be all zeros, like make_mem() gives), straight
+from the file into where each segment goes. Returns 0 if it isn't an image, it's from a
+newer version, it's been cut off or the checksum's wrong, and then whatever it had
+already loaded is still in memory.
+*/
+uint8_t load_image(uint8_t *mem, const char *path) {
+	uint8_t header[IMAGE_HEADER_SIZE];
+	uint8_t segment_header[8];
+	uint32_t checksum = FNV_START;
+
+	FILE *fptr = fopen(path, "rb");
+	if (fptr == NULL) {
+		return 0;
+	}
+	if (fread(header, 1, sizeof(header), fptr) != sizeof(header) || memcmp(header, "6502", 4) != 0 ||
+		get_u32(&header[4]) > IMAGE_VERSION) {
+		fclose(fptr);
+		return 0;
+	}
+
+	uint32_t segments = get_u32(&header[8]);
+	for (uint32_t i = 0; i < segments; i++) {
+		if (fread(segment_header, 1, sizeof(segment_header), fptr) != sizeof(segment_header)) {
+			fclose(fptr);
+			return 0;
+		}
+		uint32_t start = get_u32(&segment_header[0]);
+		uint32_t length = get_u32(&segment_header[4]);
+		if (start > MAX_MEM || length > MAX_MEM + 1 - start ||
+			fread(&mem[start], 1, length, fptr) != length) {
+			fclose(fptr);
+			return 0;
+		}
+		checksum = fnv1a(checksum, segment_header, sizeof(segment_header));
+		checksum = fnv1a(checksum, &mem[start], length);
+	}
+	fclose(fptr);
+
+	if (checksum != get_u32(&header[20])) {
+		return 0;
+	}
+	for (uint8_t i = 0; i < 3; i++) {
+		mem[0xFFFFFA + i] = get_u32(&header[12]) >> (i * 8);
+		mem[0xFFFFFD + i] = get_u32(&header[16]) >> (i * 8);
+	}
+
+	return 1;
+}
@@ -0,0 +1,1265 @@
+/*
+The body of every instruction, shared by all of the ways of running them (the
+switch in execute() and the threaded engine in dispatch.c). This file gets
+included in the middle of a function, so before including it you need:
+
+OP(opcode) - starts an instruction (e.g. "case opcode:") and adds on its
+	instruction_cycles (the bodies only add any extra cycles themselves)
+END_OP - ends it (e.g. "break;")
+OP_BAIL - gives up on the instruction without moving on to the next one
+OPERAND_BYTE - the byte after the opcode (once *address has been moved onto it)
+OPERAND_ABS - the 3 byte address starting there, moving *address onto its last byte
+	like getAddr() does
+LOAD(a) - reads mem[a] for an instruction's data, where it might be a device
+	(see bus.c, zero page reads don't need it)
+STORE(a, v) - writes v to mem[a]
+WROTE(a, length) - says something else (fgets, a uint32_t*) just wrote there
+PUSH(v)/POP() - stackPush()/stackPop()
+SAVE_PROG() - saves prog.txt like save_prog() (or starts saving it), 0 if it couldn't
+KEYBOARD_LINE() - puts the next line of input at keyboard_addr like fgets() (or takes it
+	from the keyboard, see keyboard.c), 0 if there isn't one yet
+WAIT_INPUT - stops without running the instruction, to run it again once there's input
+
+and "data", "mem", "address", "testing_mode" and "keyboard_addr" in scope, same
+as the arguments to execute(), plus INSTRUCTION_LOCALS (from cpu6502.c) at the
+top of the function for the scratch variables.
+
+Memory has to be written with STORE/PUSH/POP (or followed by WROTE) so the threaded
+engine can tell when the program writes over code it has cached (see predecode.c).
+
+Like before, *address is left on the last byte of the instruction and the
+caller moves it on to the next one.
+*/
+
+		OP(MTA_OFF_IP)
+			data -> clk = 0;
+			SET_C(data, 0);
+			END_OP
+		OP(MTA_SAV_IP)
+			if (!SAVE_PROG()) {
+				perror("AHHH ABORT ABORT FAILED TO OPEN FILE!!! AH!!!!");
+				OP_BAIL;
+			}
+			END_OP
+		OP(MTA_OFS_IP)
+			if (!SAVE_PROG()) {
+				perror("AHHH ABORT ABORT FAILED TO OPEN FILE!!! AH!!!!");
+				OP_BAIL;
+			}
+			data -> clk = 0;
+			END_OP
+		OP(MTA_KYB_IP)
+			if (!KEYBOARD_LINE()) {
+				data -> cyclenum -= instruction_cycles[MTA_KYB_IP]; // It'll get them next time
+				WAIT_INPUT;
+			}
+			WROTE(keyboard_addr - mem, 250);
+			END_OP
+		OP(INS_BRK_IP)
+			temp = 0xFFFFFD;
+			PUSH(*address);
+			PUSH((*address >> 8));
+			PUSH((*address >> 16));
+			PUSH(getPS(*data));
+			data -> B = 1;
+			*address = getAddr(data, &temp, mem);
+			if (testing_mode > 1) {
+				printf("Interrupted to: %06x\n", *address);
+			}
+			END_OP
+		OP(INS_STA_ZP)
+			(*address)++;
+			STORE(OPERAND_BYTE, data -> A);
+			//printf("storing to: %02x\n", OPERAND_BYTE);
+			END_OP
+		OP(INS_STA_ZX)
+			(*address)++;
+			STORE((OPERAND_BYTE + data -> X) & 0b11111111, data -> A);
+			END_OP
+		OP(INS_STA_AB)
+			(*address)++;
+			STORE(OPERAND_ABS, data -> A);
+			END_OP
+		OP(INS_STA_AX)
+			(*address)++;
+			temp = OPERAND_ABS + data -> X;
+			STORE(temp, data -> A);
+			END_OP
+		OP(INS_STA_AY)
+			(*address)++;
+			STORE(OPERAND_ABS + data -> Y, data -> A);
+			END_OP
+		OP(INS_STA_IX)
+			(*address)++;
+			temp = mem[(OPERAND_BYTE + data -> X) & 0b11111111];
+			STORE(getAddr(data, &temp, mem), data -> A);
+			END_OP
+		OP(INS_STA_IY)
+			(*address)++;
+			temp = OPERAND_BYTE;
+			STORE(getAddr(data, &temp, mem) + data -> Y, data -> A);
+			END_OP
+		OP(INS_RTI_IP)
+			setPS(data, POP());
+			// BRK (and an interrupt) push it low byte first, like JSR
+			temp = POP() << 16;
+			temp |= (POP() << 8);
+			temp |= POP();
+			*address = temp;
+			END_OP
+		OP(INS_STX_ZP)
+			(*address)++;
+			STORE(OPERAND_BYTE, data -> X);
+			END_OP
+		OP(INS_STX_ZY)
+			(*address)++;
+			STORE((OPERAND_BYTE + data -> Y) & 0b11111111, data -> X);
+			END_OP
+		OP(INS_STX_AB)
+			(*address)++;
+			STORE(OPERAND_ABS, data -> X);
+			END_OP
+		OP(INS_STY_AB)
+			(*address)++;
+			STORE(OPERAND_ABS, data -> Y);
+			END_OP
+		OP(INS_STY_ZP)
+			(*address)++;
+			STORE(OPERAND_BYTE, data -> Y);
+			END_OP
+		OP(INS_STY_ZX)
+			(*address)++;
+			STORE((OPERAND_BYTE + data -> X) & 0b11111111, data -> Y);
+			END_OP
+		OP(INS_TAX_IP)
+			data -> X = data -> A;
+			SET_ZN(data, data -> X);
+			END_OP
+		OP(INS_TAY_IP)
+			data -> Y = data -> A;
+			SET_ZN(data, data -> Y);
+			END_OP
+		OP(INS_TYA_IP)
+			data -> A = data -> Y;
+			SET_ZN(data, data -> A);
+			END_OP
+		OP(INS_TXA_IP)
+			data -> A = data -> X;
+			SET_ZN(data, data -> A);
+			END_OP
+		OP(INS_TSX_IP)
+			data -> X = data -> SP;
+			SET_ZN(data, data -> X);
+			END_OP
+		OP(INS_TXS_IP)
+			data -> SP = data -> X;
+			END_OP
+		OP(INS_DEC_ZP)
+			(*address)++;
+			temp = OPERAND_BYTE;
+			STORE(temp, mem[temp] - 1);
+			END_OP
+		OP(INS_DEC_ZX)
+			(*address)++;
+			temp = (OPERAND_BYTE + data -> X) & 0b11111111;
+			STORE(temp, mem[temp] - 1);
+			END_OP
+		OP(INS_DEC_AB)
+			(*address)++;
+			temp = OPERAND_ABS;
+			STORE(temp, mem[temp] - 1);
+			END_OP
+		OP(INS_DEC_AX)
+			(*address)++;
+			temp = OPERAND_ABS + data -> X;
+			STORE(temp, mem[temp] - 1);
+			END_OP
+		OP(INS_INC_ZP)
+			(*address)++;
+			temp = (uint32_t) OPERAND_BYTE;
+			//printf("Incrementing address %06x at address %06x\n", temp, *address);
+			STORE(temp, mem[temp] + 1);
+			SET_Z(data, (mem[temp] == 0));
+			data -> B = ((mem[temp] & 0b10000000) > 1);
+			END_OP
+		OP(INS_INC_ZX)
+			(*address)++;
+			temp = (OPERAND_BYTE + data -> X) & 0b11111111;
+			STORE(temp, mem[temp] + 1);
+			SET_Z(data, (mem[temp] == 0));
+			data -> B = ((mem[temp] & 0b10000000) > 1);
+			END_OP
+		OP(INS_INC_AB)
+			(*address)++;
+			temp = OPERAND_ABS;
+			STORE(temp, mem[temp] + 1);
+			SET_Z(data, (mem[temp] == 0));
+			data -> B = ((mem[temp] & 0b10000000) > 1);
+			END_OP
+		OP(INS_INC_AX)
+			(*address)++;
+			temp = OPERAND_ABS + data -> X;
+			STORE(temp, mem[temp] + 1);
+			SET_Z(data, (mem[temp] == 0));
+			data -> B = ((mem[temp] & 0b10000000) > 1);
+			END_OP
+		OP(INS_DEX_IP)
+			data -> X--;
+			SET_Z(data, (data -> X == 0));
+			data -> B = ((data -> X & 0b10000000)> 1);
+			END_OP
+		OP(INS_INX_IP)
+			data -> X++;
+			SET_Z(data, (data -> X == 0));
+			data -> B = ((data -> X & 0b10000000) > 1);
+			END_OP
+		OP(INS_DEY_IP)
+			data -> Y--;
+			SET_Z(data, (data -> Y == 0));
+			data -> B = ((data -> Y & 0b10000000) > 1);
+			END_OP
+		OP(INS_INY_IP)
+			data -> Y++;
+			SET_Z(data, (data -> Y == 0));
+			data -> B = ((data -> Y & 0b10000000) > 1);
+			END_OP
+		OP(INS_ROL_AC)
+			temp = (data -> A & 0b10000000);
+			data -> A <<= 1;
+			data -> A += GET_C(data);
+			SET_C(data, temp);
+			SET_Z(data, (data -> A == 0));
+			END_OP
+		OP(INS_ROL_ZP)
+			(*address)++;
+			temp2 = OPERAND_BYTE;
+			temp = (mem[temp2] & 0b10000000);
+			STORE(temp2, (mem[temp2] << 1) + GET_C(data));
+			SET_C(data, temp);
+			SET_Z(data, (mem[temp2] & 0b10000000 == 0));
+			END_OP
+		OP(INS_ROL_ZX)
+			(*address)++;
+			temp2 = (OPERAND_BYTE + data -> X) & 0b11111111;
+			temp = (mem[temp2] & 0b10000000);
+			STORE(temp2, (mem[temp2] << 1) + GET_C(data));
+			SET_C(data, temp);
+			SET_Z(data, (mem[temp2] == 0));
+			END_OP
+		OP(INS_ROL_AB)
+			(*address)++;
+			temp2 = OPERAND_ABS;
+			temp = (mem[temp2] & 0b10000000);
+			STORE(temp2, (mem[temp2] << 1) + GET_C(data));
+			SET_C(data, temp);
+			SET_Z(data, (mem[temp2] == 0));
+			END_OP
+		OP(INS_ROL_AX)
+			(*address)++;
+			temp2 = OPERAND_ABS + data -> X;
+			temp = (mem[temp2] & 0b10000000);
+			STORE(temp2, (mem[temp2] << 1) + GET_C(data));
+			SET_C(data, temp);
+			SET_Z(data, (mem[temp2] == 0));
+			END_OP
+		OP(INS_ROR_AC)
+			temp = (data -> A & 0b10000000);
+			data -> A >>= 1;
+			data -> A += GET_C(data);
+			SET_C(data, temp);
+			SET_Z(data, (data -> A == 0));
+			END_OP
+		OP(INS_ROR_ZP)
+			(*address)++;
+			temp2 = OPERAND_BYTE;
+			temp = (mem[temp2] & 0b10000000);
+			STORE(temp2, (mem[temp2] >> 1) + GET_C(data));
+			SET_C(data, temp);
+			SET_Z(data, (mem[temp2] & 0b10000000 == 0));
+			END_OP
+		OP(INS_ROR_ZX)
+			(*address)++;
+			temp2 = (OPERAND_BYTE + data -> X) & 0b11111111;
+			temp = (mem[temp2] & 0b10000000);
+			STORE(temp2, (mem[temp2] >> 1) + GET_C(data));
+			SET_C(data, temp);
+			SET_Z(data, (mem[temp2] == 0));
+			END_OP
+		OP(INS_ROR_AB)
+			(*address)++;
+			temp2 = OPERAND_ABS;
+			temp = (mem[temp2] & 0b10000000);
+			STORE(temp2, (mem[temp2] >> 1) + GET_C(data));
+			SET_C(data, temp);
+			SET_Z(data, (mem[temp2] == 0));
+			END_OP
+		OP(INS_ROR_AX)
+			(*address)++;
+			temp2 = OPERAND_ABS + data -> X;
+			temp = (mem[temp2] & 0b10000000);
+			STORE(temp2, (mem[temp2] >> 1) + GET_C(data));
+			SET_C(data, temp);
+			SET_Z(data, (mem[temp2] == 0));
+			END_OP
+		OP(INS_ASL_AC)
+			SET_C(data, ((data -> A & 0b10000000) > 0));
+			data -> A <<= 1;
+			SET_ZN(data, data -> A);
+			END_OP
+		OP(INS_ASL_ZP)
+			temp1 = (uint32_t*) &(mem[mem[*address]]);
+			(*address)++;
+			SET_C(data, ((*temp1 & 0b10000000) > 0));
+			*temp1 <<= 1;
+			WROTE((uint8_t*) temp1 - mem, 4);
+			SET_Z(data, (*temp1 == 0));
+			SET_N(data, ((*temp1 & 0b10000000) > 0));
+			END_OP
+		OP(INS_ASL_ZX)
+			(*address)++;
+			temp1 = (uint32_t*) (uint8_t*) &(mem[OPERAND_BYTE + data -> X]);
+			SET_C(data, ((*temp1 & 0b10000000) > 0));
+			*temp1 <<= 1;
+			WROTE((uint8_t*) temp1 - mem, 4);
+			SET_Z(data, (*temp1 == 0));
+			SET_N(data, ((*temp1 & 0b10000000) > 0));
+			END_OP
+		OP(INS_ASL_AB)
+			(*address)++;
+			temp1 = (uint32_t*) &(mem[OPERAND_ABS]);
+			SET_C(data, ((*temp1 & 0b10000000) > 0));
+			*temp1 <<= 1;
+			WROTE((uint8_t*) temp1 - mem, 4);
+			SET_Z(data, (*temp1 == 0));
+			SET_N(data, ((*temp1 & 0b10000000) > 0));
+			END_OP
+		OP(INS_ASL_AX)
+			(*address)++;
+			temp1 = (uint32_t*) &(mem[OPERAND_ABS + data -> X]);
+			SET_C(data, ((*temp1 & 0b10000000) > 0));
+			*temp1 <<= 1;
+			WROTE((uint8_t*) temp1 - mem, 4);
+			SET_Z(data, (*temp1 == 0));
+			SET_N(data, ((*temp1 & 0b10000000) > 0));
+			END_OP
+		OP(INS_LSR_AC)
+			SET_C(data, ((data -> A & 0b00000001) > 0));
+			data -> A >>= 1;
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, 0);
+			END_OP
+		OP(INS_LSR_ZP)
+			temp1 = (uint32_t*) &(mem[mem[*address]]);
+			(*address)++;
+			SET_C(data, ((*temp1 & 0b00000001) > 0));
+			*temp1 >> 1;
+			SET_Z(data, (*temp1 == 0));
+			SET_N(data, 0);
+			END_OP
+		OP(INS_LSR_ZX)
+			(*address)++;
+			temp1 = (uint32_t*) (uint8_t*) &(mem[OPERAND_BYTE + data -> X]);
+			SET_C(data, ((*temp1 & 0b00000001) > 0));
+			*temp1 >> 1;
+			SET_Z(data, (*temp1 == 0));
+			SET_N(data, 0);
+			END_OP
+		OP(INS_LSR_AB)
+			(*address)++;
+			temp1 = (uint32_t*) &(mem[OPERAND_ABS]);
+			SET_C(data, ((*temp1 & 0b00000001) > 0));
+			*temp1 >> 1;
+			SET_Z(data, (*temp1 == 0));
+			SET_N(data, 0);
+			END_OP
+		OP(INS_LSR_AX)
+			(*address)++;
+			temp1 = (uint32_t*) &(mem[OPERAND_ABS + data -> X]);
+			SET_C(data, ((*temp1 & 0b00000001) > 0));
+			*temp1 >> 1;
+			SET_Z(data, (*temp1 == 0));
+			SET_N(data, 0);
+			END_OP
+		OP(INS_CMP_IM)
+			(*address)++;
+			temp = (uint8_t) (data -> A - OPERAND_BYTE);
+			if (testing_mode > 2) {
+				printf("Comparing A with %02x\n", OPERAND_BYTE);
+				printf("A is %02x\n", data -> A);
+			}
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			END_OP
+		OP(INS_CMP_ZP)
+			(*address)++;
+			temp = (uint8_t) (data -> A - mem[OPERAND_BYTE]);
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			END_OP
+		OP(INS_CMP_ZX)
+			(*address)++;
+			temp = (uint8_t) (data -> A - mem[(OPERAND_BYTE + data -> X) & 0b11111111]);
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			END_OP
+		OP(INS_CMP_AB)
+			(*address)++;
+			temp = (uint8_t) (data -> A - LOAD(OPERAND_ABS));
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			END_OP
+		OP(INS_CMP_AX)
+			(*address)++;
+			addr = OPERAND_ABS;
+			temp = (uint8_t) (data -> A - LOAD(addr + data -> X));
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> X);
+			END_OP
+		OP(INS_CMP_AY)
+			(*address)++;
+			addr = OPERAND_ABS;
+			temp = (uint8_t) (data -> A - LOAD(addr + data -> Y));
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_CMP_IX)
+			(*address)++;
+			temp3 = mem[(OPERAND_BYTE + data -> X) & 0b11111111];
+			temp = (data -> A - mem[temp3]) & 0b11111111;
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			END_OP
+		OP(INS_CMP_IY)
+			(*address)++;
+			temp4 = OPERAND_BYTE;
+			addr = getAddr(data, &temp4, mem);
+			temp2 = addr + data -> Y;
+			temp = (data -> A - LOAD(temp2)) & 0b11111111;
+			//printf("%02x%02x%02x\n", mem[0x000080], mem[0x000081], mem[0x000082]);
+			//printf("Comparing A with val at val at: %02x\n", temp4 - 2);
+			//printf("Comparing A with val at: %06x\n", temp2);
+			//printf("Comparing A with: %02x\n", mem[temp2]);
+			//printf("A is: %02x\n", data -> A);
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_CPX_IM)
+			(*address)++;
+			temp = (uint8_t) data -> X - OPERAND_BYTE;
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			END_OP
+		OP(INS_CPX_ZP)
+			(*address)++;
+			temp = (uint8_t) data -> X - mem[OPERAND_BYTE];
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			END_OP
+		OP(INS_CPX_AB)
+			(*address)++;
+			temp = (uint8_t) data -> X - OPERAND_BYTE;
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			END_OP
+		OP(INS_CPY_IM)
+			(*address)++;
+			temp = (uint8_t) data -> Y - OPERAND_BYTE;
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			END_OP
+		OP(INS_CPY_ZP)
+			(*address)++;
+			temp = (uint8_t) data -> Y - mem[OPERAND_BYTE];
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			END_OP
+		OP(INS_CPY_AB)
+			(*address)++;
+			temp = (uint8_t) data -> Y - OPERAND_BYTE;
+			SET_N(data, ((temp & 0b10000000) > 0));
+			SET_C(data, ((temp & 0b10000000) == 0));
+			SET_Z(data, (temp == 0));
+			END_OP
+		OP(INS_AND_IM)
+			(*address)++;
+			data -> A = (data -> A & OPERAND_BYTE);
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_AND_ZP)
+			(*address)++;
+			data -> A = (data -> A & mem[OPERAND_BYTE]);
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_AND_ZX)
+			(*address)++;
+			data -> A = (data -> A & (uint8_t) (mem[OPERAND_BYTE + data -> X]));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_AND_AB)
+			(*address)++;
+			data -> A = (data -> A & (uint8_t) LOAD(OPERAND_ABS));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_AND_AX)
+			(*address)++;
+			addr = OPERAND_ABS;
+			data -> A = (data -> A & (uint8_t) LOAD(addr + data -> X));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> X);
+			END_OP
+		OP(INS_AND_AY)
+			(*address)++;
+			addr = OPERAND_ABS;
+			data -> A = (data -> A & (uint8_t) LOAD(addr + data -> Y));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_AND_IX)
+			(*address)++;
+			temp = (uint8_t) (OPERAND_BYTE + data -> X);
+			data -> A = (data -> A & LOAD(getAddr(data, &temp, mem)));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_AND_IY)
+			(*address)++;
+			temp = (OPERAND_BYTE) & 0b11111111;
+			addr = getAddr(data, &temp, mem);
+			data -> A = (data -> A & mem[(addr + data -> Y) & 0b11111111]);
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_EOR_IM)
+			(*address)++;
+			data -> A = (data -> A ^ OPERAND_BYTE);
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_EOR_ZP)
+			(*address)++;
+			data -> A = (data -> A ^ mem[OPERAND_BYTE]);
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_EOR_ZX)
+			(*address)++;
+			data -> A = (data -> A ^ (uint8_t) (mem[OPERAND_BYTE + data -> X]));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_EOR_AB)
+			(*address)++;
+			data -> A = (data -> A ^ (uint8_t) LOAD(OPERAND_ABS));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_EOR_AX)
+			(*address)++;
+			addr = OPERAND_ABS;
+			data -> A = (data -> A ^ (uint8_t) LOAD(addr + data -> X));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> X);
+			END_OP
+		OP(INS_EOR_AY)
+			(*address)++;
+			addr = OPERAND_ABS;
+			data -> A = (data -> A ^ (uint8_t) LOAD(addr + data -> Y));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_EOR_IX)
+			(*address)++;
+			temp = (uint8_t) (OPERAND_BYTE + data -> X);
+			data -> A = (data -> A ^ LOAD(getAddr(data, &temp, mem)));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_EOR_IY)
+			(*address)++;
+			temp = (OPERAND_BYTE) & 0b11111111;
+			addr = getAddr(data, &temp, mem);
+			data -> A = (data -> A ^ mem[(addr + data -> Y) & 0b11111111]);
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_ORA_IM)
+			(*address)++;
+			data -> A = (data -> A | OPERAND_BYTE);
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_ORA_ZP)
+			(*address)++;
+			data -> A = (data -> A | mem[OPERAND_BYTE]);
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_ORA_ZX)
+			(*address)++;
+			data -> A = (data -> A | (uint8_t) (mem[OPERAND_BYTE + data -> X]));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_ORA_AB)
+			(*address)++;
+			data -> A = (data -> A | (uint8_t) LOAD(OPERAND_ABS));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_ORA_AX)
+			(*address)++;
+			addr = OPERAND_ABS;
+			data -> A = (data -> A | (uint8_t) LOAD(addr + data -> X));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> X);
+			END_OP
+		OP(INS_ORA_AY)
+			(*address)++;
+			addr = OPERAND_ABS;
+			data -> A = (data -> A | (uint8_t) LOAD(addr + data -> Y));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_ORA_IX)
+			(*address)++;
+			temp = (uint8_t) (OPERAND_BYTE + data -> X);
+			data -> A = (data -> A | LOAD(getAddr(data, &temp, mem)));
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			END_OP
+		OP(INS_ORA_IY)
+			(*address)++;
+			temp = (OPERAND_BYTE) & 0b11111111;
+			addr = getAddr(data, &temp, mem);
+			data -> A = (data -> A | mem[(addr + data -> Y) & 0b11111111]);
+			SET_Z(data, (data -> A == 0));
+			SET_N(data, (data -> A & 0b10000000 > 0));
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_PHA_IP)
+			PUSH(data -> A);
+			END_OP
+		OP(INS_PLA_IP)
+			data -> A = POP();
+			END_OP
+		OP(INS_PHP_IP)
+			PUSH(getPS(*data));
+			END_OP
+		OP(INS_PLP_IP)
+			setPS(data, POP());
+			END_OP
+		OP(INS_BVS_RL)
+			(*address)++;
+			temp = *address + 1; // Where it goes if it isn't taken
+			if (GET_V(data)) { 
+				if (OPERAND_BYTE & 0b10000000) 
+				{ 
+					*address -= OPERAND_BYTE & 0b01111111;
+				}
+				else
+				{  
+					*address += OPERAND_BYTE & 0b01111111;
+				} 
+				if (testing_mode > 1) {
+					printf("Branched to: %06x\n", *address);
+				}
+				data -> cyclenum += 1 + PAGE_CROSSED(temp, *address + 1);
+			} else {
+				if (testing_mode > 1) {
+					printf("Failed to branch. Now at address:%06x\n", *address);
+				}
+			}
+			END_OP
+		OP(INS_BVC_RL)
+			(*address)++;
+			temp = *address + 1; // Where it goes if it isn't taken
+			if (!(GET_V(data))) { 
+				if (OPERAND_BYTE & 0b10000000) 
+				{ 
+					*address -= OPERAND_BYTE & 0b01111111;
+				} 
+				else 
+				{  
+					*address += OPERAND_BYTE & 0b01111111;
+				} 
+				if (testing_mode > 1) {
+					printf("Branched to: %06x\n", *address);
+				}
+				data -> cyclenum += 1 + PAGE_CROSSED(temp, *address + 1);
+			} else {
+				if (testing_mode > 1) {
+					printf("Failed to branch. Now at address:%06x\n", *address);
+				}
+			}
+			END_OP
+		OP(INS_BCS_RL)
+			(*address)++;
+			temp = *address + 1; // Where it goes if it isn't taken
+			if (GET_C(data)) { 
+				if (OPERAND_BYTE & 0b10000000) 
+				{ 
+					*address -= OPERAND_BYTE & 0b01111111;
+				} 
+				else 
+				{  
+					*address += OPERAND_BYTE & 0b01111111;
+				} 
+				if (testing_mode > 1) {
+					printf("Branched to: %06x\n", *address);
+				}
+				data -> cyclenum += 1 + PAGE_CROSSED(temp, *address + 1);
+			} else {
+				if (testing_mode > 1) {
+					printf("Failed to branch. Now at address:%06x\n", *address);
+				}
+			}
+			END_OP
+		OP(INS_BCC_RL)
+			(*address)++;
+			temp = *address + 1; // Where it goes if it isn't taken
+			if (!(GET_C(data))) { 
+				if (OPERAND_BYTE & 0b10000000) 
+				{ 
+					*address -= OPERAND_BYTE & 0b01111111;
+				} 
+				else 
+				{  
+					*address += OPERAND_BYTE & 0b01111111;
+				} 
+				if (testing_mode > 1) {
+					printf("Branched to: %06x\n", *address);
+				}
+				data -> cyclenum += 1 + PAGE_CROSSED(temp, *address + 1);
+			} else {
+				if (testing_mode > 1) {
+					printf("Failed to branch. Now at address:%06x\n", *address);
+				}
+			}
+			END_OP
+		OP(INS_BEQ_RL)
+			(*address)++;
+			temp = *address + 1; // Where it goes if it isn't taken
+			if (GET_Z(data)) {
+				//printf("Branched from: %06x\n", *address);
+				if (OPERAND_BYTE & 0b10000000) 
+				{ 
+					*address -= OPERAND_BYTE & 0b01111111;
+				} 
+				else 
+				{  
+					*address += OPERAND_BYTE & 0b01111111;
+				}
+				if (testing_mode > 1) {
+					printf("Branched to: %06x\n", *address);
+				}
+				data -> cyclenum += 1 + PAGE_CROSSED(temp, *address + 1);
+			} else {
+				if (testing_mode > 1) {
+					printf("Failed to branch. Now at address:%06x\n", *address);
+				}
+			}
+			END_OP
+		OP(INS_BMI_RL)
+			(*address)++;
+			temp = *address + 1; // Where it goes if it isn't taken
+			if (GET_N(data)) { 
+				if (OPERAND_BYTE & 0b10000000) 
+				{ 
+					*address -= OPERAND_BYTE & 0b01111111;
+				} 
+				else 
+				{  
+					*address += OPERAND_BYTE & 0b01111111;
+				}
+				if (testing_mode > 1) {
+					printf("Branched to: %06x\n", *address);
+				}
+				data -> cyclenum += 1 + PAGE_CROSSED(temp, *address + 1);
+			} else {
+				if (testing_mode > 1) {
+					printf("Failed to branch. Now at address:%06x\n", *address);
+				}
+			}
+			END_OP
+		OP(INS_BNE_RL)
+			(*address)++;
+			temp = *address + 1; // Where it goes if it isn't taken
+			if (!(GET_Z(data))) { 
+				//printf("Branched from: %06x\n", *address);
+				if (OPERAND_BYTE & 0b10000000) 
+				{ 
+					*address -= (OPERAND_BYTE & 0b01111111) + 1;
+				} 
+				else 
+				{  
+					*address += (OPERAND_BYTE & 0b01111111) - 1;
+				}
+				if (testing_mode > 1) {
+					printf("Branched to: %06x\n", *address);
+				}
+				data -> cyclenum += 1 + PAGE_CROSSED(temp, *address + 1);
+			} else {
+				if (testing_mode > 1) {
+					printf("Failed to branch. Now at address:%06x\n", *address);
+				}
+			}
+			END_OP
+		OP(INS_BPL_RL)
+			(*address)++;
+			temp = *address + 1; // Where it goes if it isn't taken
+			if (!(GET_N(data))) { 
+				if (OPERAND_BYTE & 0b10000000) 
+				{ 
+					*address -= OPERAND_BYTE & 0b01111111;
+				} 
+				else 
+				{  
+					*address += OPERAND_BYTE & 0b01111111;
+				}
+				if (testing_mode > 1) {
+					printf("Branched to: %06x\n", *address);
+				}
+				data -> cyclenum += 1 + PAGE_CROSSED(temp, *address + 1);
+			} else {
+				if (testing_mode > 1) {
+					printf("Failed to branch. Now at address:%06x\n", *address);
+				}
+			}
+			END_OP
+		OP(INS_BIT_ZP)
+			(*address)++;
+			temp = data -> A & mem[OPERAND_BYTE];
+			SET_V(data, (temp & 0b01000000) > 0);
+			SET_N(data, (temp & 0b10000000) > 0);
+			SET_Z(data, (temp == 0));
+			END_OP
+		OP(INS_BIT_AB)
+			(*address)++;
+			temp = data -> A & LOAD(OPERAND_ABS);
+			SET_V(data, (temp & 0b01000000) > 0);
+			SET_N(data, (temp & 0b10000000) > 0);
+			SET_Z(data, (temp == 0));
+			END_OP
+		OP(INS_ADC_IM)
+			(*address)++;
+			output = data -> A + OPERAND_BYTE;
+			if (GET_C(data) == 1) { output += 256; }
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			END_OP
+		OP(INS_ADC_ZP)
+			(*address)++;
+			output = data -> A + mem[OPERAND_BYTE];
+			if (GET_C(data) == 1) { output += 256; }
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			END_OP
+		OP(INS_ADC_ZX)
+			(*address)++;
+			output = data -> A + (uint8_t) (mem[OPERAND_BYTE + data -> X]);
+			if (GET_C(data) == 1) { output += 256; }
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			END_OP
+		OP(INS_ADC_AB)
+			(*address)++;
+			output = data -> A + LOAD(OPERAND_ABS);
+			if (GET_C(data) == 1) { output += 256; }
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			END_OP
+		OP(INS_ADC_AX)
+			(*address)++;
+			addr = OPERAND_ABS;
+			output = data -> A + LOAD(addr + data -> X);
+			if (GET_C(data) == 1) { output += 256; }
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> X);
+			END_OP
+		OP(INS_ADC_AY)
+			(*address)++;
+			addr = OPERAND_ABS;
+			output = data -> A + LOAD(addr) + data -> Y;
+			if (GET_C(data) == 1) { output += 256; }
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_ADC_IX)
+			(*address)++;
+			temp = (data -> X + OPERAND_BYTE) & 0b11111111;
+			output = data -> A + LOAD(getAddr(data, &temp, mem));
+			if (GET_C(data) == 1) { output += 256; }
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			END_OP
+		OP(INS_ADC_IY)
+			(*address)++;
+			temp = OPERAND_BYTE;
+			addr = getAddr(data, &temp, mem);
+			output = data -> A + mem[(addr + data -> Y) & 0b11111111];
+			if (GET_C(data) == 1) { output += 256; }
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_SBC_IM)
+			(*address)++;
+			output = (data -> A - (!(GET_C(data)) * 256)) - OPERAND_BYTE;
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			END_OP
+		OP(INS_SBC_ZP)
+			(*address)++;
+			output = (data -> A + (!(GET_C(data)) * 256)) - mem[OPERAND_BYTE];
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			END_OP
+		OP(INS_SBC_ZX)
+			(*address)++;
+			output = (data -> A + (!(GET_C(data)) * 256)) - (uint8_t) (mem[OPERAND_BYTE + data -> X]);
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			END_OP
+		OP(INS_SBC_AB)
+			(*address)++;
+			output = (data -> A + (!(GET_C(data)) * 256)) - LOAD(OPERAND_ABS);
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			END_OP
+		OP(INS_SBC_AX)
+			(*address)++;
+			addr = OPERAND_ABS;
+			output = (data -> A + (!(GET_C(data)) * 256)) - LOAD(addr + data -> X);
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> X);
+			END_OP
+		OP(INS_SBC_AY)
+			(*address)++;
+			addr = OPERAND_ABS;
+			output = (data -> A + (!(GET_C(data)) * 256)) - LOAD(addr + data -> Y);
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_SBC_IX)
+			(*address)++;
+			temp = (data -> X + OPERAND_BYTE) & 0b11111111;
+			output = (data -> A + (!(GET_C(data)) * 256)) - LOAD(getAddr(data, &temp, mem));
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			END_OP
+		OP(INS_SBC_IY)
+			(*address)++;
+			temp = OPERAND_BYTE;
+			addr = getAddr(data, &temp, mem);
+			output = (data -> A + (!(GET_C(data)) * 256)) - mem[(addr + data -> Y) & 0b11111111];
+			SET_C(data, (output >= 256));
+			SET_V(data, ((data -> A & 0b10000000) != (output & 0b10000000)));
+			data -> A = output;
+			SET_N(data, (data -> A & 0b10000000 > 1));
+			SET_Z(data, (data -> A == 0));
+			if (testing_mode > 1) {
+				printf("accumulator: %02x\n", data -> A);
+			}
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_JMP_AB)
+			(*address)++;
+			*address = OPERAND_ABS - 1;
+			if (testing_mode > 1) {
+				printf("Address jumped to: %06x\n", (*address) + 1);
+			}
+			END_OP
+		OP(INS_JMP_ID)
+			(*address)++;
+			addr = OPERAND_ABS;
+			if (testing_mode > 1) {
+				printf("Address of address: %06x\n", addr);
+			}
+			(*address) = getAddr(data, &addr, mem) - 1;
+			if (testing_mode > 1) {
+				printf("Address jumped to: %06x\n", (*address) + 1);
+			}
+			END_OP
+		OP(INS_JSR_AB)
+			(*address)++;
+			PUSH((*address) - 1);
+			PUSH(((*address) - 1) >> 8);
+			PUSH(((*address) - 1) >> 16);
+			*address = OPERAND_ABS - 1;
+			if (testing_mode > 1) {
+				printf("Address jumped to: %06x\n", *address + 1);
+			}
+			END_OP
+		OP(INS_RTS_IP)
+			highHighByte = POP();
+			highByte = POP();
+			lowByte = POP();
+			(*address) = (lowByte | ((highByte << 8) | (highHighByte << 16))) + 3;
+			if (testing_mode > 3) {
+				printf("Low address byte: %02x\n", lowByte);
+				printf("High address byte: %02x\n", highByte);
+				printf("High high address byte: %02x\n", highHighByte);
+			}
+			if (testing_mode > 1) {
+				printf("Address returned to: %06x\n", *address + 1);
+			}
+			END_OP
+		OP(INS_LDX_IM)
+			(*address)++;
+			data -> X = OPERAND_BYTE;
+			SET_ZN(data, data -> X);
+			END_OP
+		OP(INS_LDX_ZP)
+			(*address)++;
+			data -> X = mem[OPERAND_BYTE];
+			SET_ZN(data, data -> X);
+			END_OP
+		OP(INS_LDX_ZY)
+			(*address)++;
+			data -> X = mem[mem[(*address + data -> Y) & 0b11111111]];
+			SET_Z(data, (data -> X == 0));
+			SET_N(data, ((data -> X & 0b10000000) > 0));
+			END_OP
+		OP(INS_LDX_AB)
+			(*address)++;
+			data -> X = LOAD(OPERAND_ABS);
+			SET_ZN(data, data -> X);
+			END_OP
+		OP(INS_LDX_AY)
+			(*address)++;
+			addr = OPERAND_ABS;
+			data -> X = LOAD(addr + data -> Y);
+			SET_ZN(data, data -> X);
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_LDY_IM)
+			(*address)++;
+			data -> Y = OPERAND_BYTE;
+			SET_ZN(data, data -> Y);
+			END_OP
+		OP(INS_LDY_ZP)
+			(*address)++;
+			data -> Y = mem[OPERAND_BYTE];
+			SET_ZN(data, data -> Y);
+			END_OP
+		OP(INS_LDY_ZX)
+			(*address)++;
+			data -> Y = mem[mem[(*address + data -> X) & 0b11111111]];
+			SET_ZN(data, data -> Y);
+			END_OP
+		OP(INS_LDY_AB)
+			(*address)++;
+			data -> Y = LOAD(OPERAND_ABS);
+			SET_ZN(data, data -> Y);
+			END_OP
+		OP(INS_LDY_AX)
+			(*address)++;
+			addr = OPERAND_ABS;
+			data -> Y = LOAD(addr + data -> X);
+			SET_ZN(data, data -> Y);
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> X);
+			END_OP
+		OP(INS_LDA_IM)
+			(*address)++;
+			data -> A = OPERAND_BYTE;
+			SET_ZN(data, data -> A);
+			END_OP
+		OP(INS_LDA_ZP)
+			(*address)++;
+			data -> A = mem[OPERAND_BYTE];
+			SET_ZN(data, data -> A);
+			END_OP
+		OP(INS_LDA_ZX)
+			(*address)++;
+			data -> A = mem[(OPERAND_BYTE + data -> X) & 0b11111111];
+			SET_ZN(data, data -> A);
+			END_OP
+		OP(INS_LDA_AB)
+			(*address)++;
+			data -> A = LOAD(OPERAND_ABS);
+			SET_ZN(data, data -> A);
+			END_OP
+		OP(INS_LDA_AX)
+			(*address)++;
+			addr = OPERAND_ABS;
+			temp = addr + data -> X;
+			data -> A = LOAD(temp);
+			//printf("X:%02x\n", data -> X);
+			//printf("A:%02x\n", mem[temp]);
+			//printf("A - 1:%02x\n", mem[temp - 1]);
+			//printf("A - 2:%02x\n", mem[temp - 2]);
+			//printf("A + 1:%02x\n", mem[temp + 1]);
+			//printf("A + 2:%02x\n", mem[temp + 2]);
+			SET_ZN(data, data -> A);
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> X);
+			END_OP
+		OP(INS_LDA_AY)
+			(*address)++;
+			addr = OPERAND_ABS;
+			data -> A = LOAD(addr + data -> Y);
+			SET_ZN(data, data -> A);
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_LDA_IX)
+			(*address)++;
+			temp = mem[(OPERAND_BYTE + data -> X) & 0b11111111];
+			data -> A = LOAD(getAddr(data, &temp, mem));
+			SET_ZN(data, data -> A);
+			END_OP
+		OP(INS_LDA_IY)
+			(*address)++;
+			temp = OPERAND_BYTE;
+			//printf("addr addr: %02x\n", temp);
+			addr = getAddr(data, &temp, mem);
+			temp = addr + data -> Y;
+			//printf("addr: %06x\n", temp);
+			//printf("val: %02x\n", mem[temp]);
+			data -> A = LOAD(temp);
+			SET_ZN(data, data -> A);
+			data -> cyclenum += PAGE_CROSSED(addr, addr + data -> Y);
+			END_OP
+		OP(INS_CLD_IP)
+			data -> D = 0;
+			END_OP
+		OP(INS_SED_IP)
+			data -> D = 1;
+			END_OP
+		OP(INS_CLC_IP)
+			SET_C(data, 0);
+			END_OP
+		OP(INS_SEC_IP)
+			SET_C(data, 1);
+			END_OP
+		OP(INS_CLI_IP)
+			data -> I = 0;
+			END_OP
+		OP(INS_SEI_IP)
+			data -> I = 1;
+			END_OP
+		OP(INS_CLV_IP)
+			SET_V(data, 0);
+			END_OP
+		OP(INS_NOP_IP)
+			END_OP
@@ -0,0 +1,229 @@
+/*******************************************************
+
+Interrupts: the IRQ and NMI lines, and a controller for
+them.
+
+Every device that can interrupt gets its own source, a
+bit of m -> irq, and holds it with raise_irq() until
+whatever it wanted has been dealt with (then it calls
+lower_irq()), so it's level triggered like on a real
+6502. Sources 0 to 30 are the IRQ. The program can turn
+all of them off at once with SEI, or just some of them
+with m -> irq_mask (through the controller, see below,
+or the host with set_irq_mask()). Any that are held while
+they're masked just wait.
+
+Source 31 (IRQ_NMI) is the NMI, which SEI and the mask
+don't stop. It's edge triggered: raise_nmi() is the edge,
+and it gets taken once for it and lowered by taking it,
+so nothing has to acknowledge it (another raise_nmi()
+before it's been taken is the same NMI, it doesn't
+queue up).
+
+When more than one's waiting the NMI goes first, then
+the IRQ source with the lowest number. All of the IRQs go
+through the same vector (IRQ_VECTOR, like BRK), so the
+interrupt routine asks the controller which one it was
+for (or asks every device).
+
+Interrupts only get taken between instructions: at the
+end of each one in the switch and threaded engines
+(CHECK_STOP in dispatch.c) and between blocks in the JIT
+and AOT, which raise_irq() kicks out of compiled code. All
+they do there is INTERRUPT_PENDING(), and since m -> irq
+is 0 nearly all of the time that's one load and a branch
+that always goes the same way. It only looks any further
+once something's been raised.
+
+Each source's latency (cycles from raise_irq() to the
+interrupt routine starting) gets added up in
+m -> irq_stats, for interrupt_stats(). It counts from the
+edge, so a source that's held the whole time only counts
+for the first time it's taken.
+
+add_interrupt_controller() puts the controller's
+registers on the bus at start:
+	start + 0 to 3 (IRQ_PENDING, read only): the sources
+		that are raised, little endian
+	start + 4 to 7 (IRQ_MASK): the ones that are allowed
+		to interrupt (all of them to start with, the NMI
+		always is)
+	start + 8 (IRQ_SOURCE, read only): the one that
+		interrupted, the unmasked IRQ source with the
+		lowest number, or IRQ_NO_SOURCE if there isn't
+		one
+The mask goes in snapshots (the lines don't, the devices
+raise them again, see resume_timer()).
+
+*******************************************************/
+
+#define IRQ_NMI (IRQ_SOURCES - 1)
+#define NMI_VECTOR 0xFFFFF7 // Just under the reset vector, like on a real 6502
+#define IRQ_VECTOR 0xFFFFFD
+#define IRQ_NOT_RAISED UINT64_MAX // In m -> irq_raised, it's been taken (or it's not up)
+
+// The controller's registers, from start
+#define IRQ_PENDING 0
+#define IRQ_MASK 4
+#define IRQ_SOURCE 8
+#define IRQ_CONTROLLER_SIZE 9
+
+#define IRQ_NO_SOURCE 0xFF
+
+struct interrupt_controller {
+	struct machine *m;
+	uint32_t start;
+};
+
+#define INTERRUPT_PENDING(m) ((m) -> irq && ((m) -> irq & (m) -> irq_mask) && (!(m) -> data.I || ((m) -> irq >> IRQ_NMI)))
+
+// Each source should only be raised from one thread (they can all be different ones)
+void raise_irq(struct machine *m, uint8_t source) {
+	uint32_t bit = (uint32_t) 1 << source;
+
+	// Only when it goes up, if it was already up it's still waiting from then
+	if (!(__atomic_load_n(&m -> irq, __ATOMIC_SEQ_CST) & bit)) {
+		__atomic_store_n(&m -> irq_raised[source], __atomic_load_n(&m -> data.cyclenum, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+	}
+	__atomic_fetch_or(&m -> irq, bit, __ATOMIC_SEQ_CST);
+	// Compiled code only looks at this between instructions, so it has to come out for it
+	__atomic_store_n(&m -> jit_exit, 1, __ATOMIC_RELAXED);
+
+	return;
+}
+
+void lower_irq(struct machine *m, uint8_t source) {
+	__atomic_fetch_and(&m -> irq, ~((uint32_t) 1 << source), __ATOMIC_SEQ_CST);
+
+	return;
+}
+
+void raise_nmi(struct machine *m) {
+	raise_irq(m, IRQ_NMI);
+
+	return;
+}
+
+// Sets which IRQ sources can interrupt (a bit for each, the NMI can't be masked)
+void set_irq_mask(struct machine *m, uint32_t mask) {
+	uint32_t unmasked = mask & ~m -> irq_mask;
+
+	m -> irq_mask = mask | ((uint32_t) 1 << IRQ_NMI);
+	// Anything that was waiting on the mask can go now, and compiled code has to notice
+	if (__atomic_load_n(&m -> irq, __ATOMIC_SEQ_CST) & unmasked) {
+		__atomic_store_n(&m -> jit_exit, 1, __ATOMIC_RELAXED);
+	}
+
+	return;
+}
+
+// The IRQ source that goes next (ignoring I), IRQ_NO_SOURCE if there isn't one
+uint8_t next_irq_source(struct machine *m) {
+	uint32_t waiting = __atomic_load_n(&m -> irq, __ATOMIC_SEQ_CST) & m -> irq_mask & ~((uint32_t) 1 << IRQ_NMI);
+
+	if (waiting == 0) {
+		return IRQ_NO_SOURCE;
+	}
+
+	return __builtin_ctz(waiting);
+}
+
+// The latency so far for source (IRQ_NMI for the NMI)
+const struct irq_stats *interrupt_stats(struct machine *m, uint8_t source) {
+	return &m -> irq_stats[source];
+}
+
+/*
+Goes into the interrupt routine at the end of an instruction, the same way BRK does (it
+starts one byte after the address at IRQ_VECTOR, or NMI_VECTOR for an NMI), except B is
+clear in what gets pushed and RTI comes back to the instruction that was going to run next.
+*/
+void take_irq(struct machine *m) {
+	struct data *data = &m -> data;
+	uint32_t back = data -> PC - 1; // RTI goes on to the instruction after the one it pulls
+	uint32_t temp = IRQ_VECTOR;
+	uint32_t waiting = __atomic_load_n(&m -> irq, __ATOMIC_SEQ_CST) & m -> irq_mask;
+	uint8_t source;
+
+	if (waiting >> IRQ_NMI) {
+		// It's an edge, so taking it is what lowers it
+		__atomic_fetch_and(&m -> irq, ~((uint32_t) 1 << IRQ_NMI), __ATOMIC_SEQ_CST);
+		temp = NMI_VECTOR;
+		source = IRQ_NMI;
+	} else if (waiting != 0 && !data -> I) {
+		source = __builtin_ctz(waiting);
+	} else {
+		return; // Another thread lowered it in the meantime
+	}
+
+	struct irq_stats *stats = &m -> irq_stats[source];
+	uint64_t raised = __atomic_load_n(&m -> irq_raised[source], __ATOMIC_RELAXED);
+	stats -> taken++;
+	if (raised <= data -> cyclenum) {
+		uint64_t latency = data -> cyclenum + 7 - raised; // Until the routine starts
+		stats -> measured++;
+		stats -> total_latency += latency;
+		if (latency > stats -> worst_latency) {
+			stats -> worst_latency = latency;
+		}
+		__atomic_store_n(&m -> irq_raised[source], IRQ_NOT_RAISED, __ATOMIC_RELAXED);
+	}
+
+	// The same way round as BRK (and JSR), so RTI can pull it back off either way
+	push_byte(m, back, m -> testing_mode);
+	push_byte(m, back >> 8, m -> testing_mode);
+	push_byte(m, back >> 16, m -> testing_mode);
+	push_byte(m, getPS(*data) & 0b11101111, m -> testing_mode);
+	data -> I = 1;
+	data -> PC = getAddr(data, &temp, m -> mem) + 1;
+	data -> cyclenum += 7;
+	m -> irqs_taken++;
+	m -> jit_last = NULL; // It didn't leave the block for where it's going now
+	m -> idle_at = IDLE_NONE; // Coming back to a loop from here isn't going round it (see idle.c)
+
+	return;
+}
+
+uint8_t interrupt_controller_read(struct machine *m, void *ctx, uint32_t address) {
+	struct interrupt_controller *controller = (struct interrupt_controller*) ctx;
+	uint32_t offset = address - controller -> start;
+
+	if (offset < IRQ_MASK) {
+		return __atomic_load_n(&m -> irq, __ATOMIC_SEQ_CST) >> (8 * (offset - IRQ_PENDING));
+	}
+	if (offset < IRQ_SOURCE) {
+		return m -> irq_mask >> (8 * (offset - IRQ_MASK));
+	}
+
+	return next_irq_source(m);
+}
+
+void interrupt_controller_write(struct machine *m, void *ctx, uint32_t address, uint8_t value) {
+	struct interrupt_controller *controller = (struct interrupt_controller*) ctx;
+	uint32_t offset = address - controller -> start;
+
+	if (offset < IRQ_MASK || offset >= IRQ_SOURCE) {
+		return;
+	}
+	uint32_t shift = 8 * (offset - IRQ_MASK);
+	set_irq_mask(m, (m -> irq_mask & ~((uint32_t) 0xFF << shift)) | ((uint32_t) value << shift));
+
+	return;
+}
+
+/*
+Puts the interrupt controller's registers on the bus from start (to start +
+IRQ_CONTROLLER_SIZE - 1). Returns 0 if it couldn't.
+*/
+uint8_t add_interrupt_controller(struct machine *m, struct interrupt_controller *controller, uint32_t start) {
+	controller -> m = m;
+	controller -> start = start;
+
+	if (!add_device(m, start, start + IRQ_CONTROLLER_SIZE - 1, interrupt_controller_read, interrupt_controller_write, controller)) {
+		return 0;
+	}
+	// The mask's all the state it's got, and it's the machine's
+	device_state(m, start, &m -> irq_mask, sizeof(m -> irq_mask));
+
+	return 1;
+}
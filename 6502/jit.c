@@ -0,0 +1,781 @@
+/*******************************************************
+
+ENGINE_JIT: compiles the program into x86-64 code, one
+basic block at a time.
+
+A block starts wherever the program goes and carries on
+until a jump, branch, JSR, RTS, RTI or BRK (or it gets
+to JIT_MAX_BLOCK instructions). Each instruction in it
+becomes a direct call to that instruction's body, built
+from instruction_bodies.c as its own function, with the
+operand already worked out and passed in. That gets rid
+of all of the fetching, decoding and dispatching, and
+the blocks jump straight into each other ("chaining")
+instead of going back to run_jit() every time, as long
+as the budgets haven't run out.
+
+Since the bodies are the same ones the interpreter uses
+the JIT can't disagree with it on what an instruction
+does. The interpreter (the threaded engine) still does
+the meta instructions (MTA_KYB_IP, MTA_SAV_IP etc., they
+talk to the host), tracing, breakpoints and run_until()
+conditions, since those all need to see every single
+instruction.
+
+Budgets are only checked between blocks, so run_for()
+can go up to a block over. run_steps() is still exact,
+it just doesn't use compiled code for the last few.
+
+If the program writes over a byte that's been compiled,
+all of the compiled code is thrown away (the block that
+did it stops straight after the write) and it gets
+compiled again from what's in memory now.
+
+Only for x86-64 with GCC/clang on a unix, anything else
+just gets the threaded engine.
+
+*******************************************************/
+
+#if defined(__x86_64__) && defined(__GNUC__) && defined(__unix__)
+
+#include <stddef.h>
+#include <sys/mman.h>
+
+#define JIT_CODE_SIZE (16 * 1024 * 1024) // Bytes of compiled code before it all gets thrown away
+#define JIT_MAX_BLOCKS 65536
+#define JIT_MAX_BLOCK 32 // Instructions in a block
+#define JIT_BLOCK_BYTES 4096 // More than the most code a block can turn into
+#define JIT_LOOKUP_SIZE 65536
+#define JIT_LOOKUP_MASK (JIT_LOOKUP_SIZE - 1)
+
+// Where things are in the machine, for the compiled code (which keeps the machine in rbx)
+#define AT(field) ((uint32_t) offsetof(struct machine, field))
+
+// The size of a chain slot, and where its target address and jump are in it (see end_block())
+#define SLOT_SIZE 59
+#define SLOT_ADDRESS 6
+#define SLOT_JUMP 55
+
+struct jit_block {
+	uint32_t address; // Where it starts in the program
+	uint8_t *entry; // What run_jit() calls
+	uint8_t *body; // Where other blocks jump to (the machine is already in rbx)
+	uint8_t *slots; // Two chain slots, each one can be pointed at another block
+	uint8_t slots_used;
+};
+
+// Where compiled code finds a flag: it's set if (byte & mask) != 0, or == 0 if inverted
+struct jit_flag {
+	uint32_t offset;
+	uint8_t mask;
+	uint8_t inverted;
+};
+
+struct jit {
+	uint8_t *code;
+	uint32_t used;
+	struct jit_block blocks[JIT_MAX_BLOCKS];
+	uint32_t block_count;
+	struct jit_block *lookup[JIT_LOOKUP_SIZE]; // Blocks by the bottom 16 bits of their address
+	uint8_t *compiled; // One bit for every byte of memory, set if it's part of a compiled instruction
+	uint32_t flushes; // Goes up every time the compiled code gets thrown away
+
+	// Which bit of the flags byte (the start of struct data) each flag is
+	uint8_t flag_i, flag_d, flag_b;
+	struct jit_flag flag_c, flag_z, flag_v, flag_n; // These might be lazy (see LAZY_FLAGS)
+};
+
+// Every instruction body as a function, so compiled code can call them
+#define OP(opcode) void jit_##opcode(struct machine *m, uint32_t operand) { \
+	struct data *data = &m -> data; \
+	uint8_t *mem = m -> mem; \
+	uint32_t *address = &data -> PC; \
+	uint8_t *keyboard_addr = m -> keyboard_addr; \
+	const uint8_t testing_mode = 0; \
+	INSTRUCTION_LOCALS \
+	INSTRUCTION_LOCALS_UNUSED \
+	(void) mem; (void) address; (void) keyboard_addr; (void) testing_mode; (void) operand; \
+	data -> cyclenum += instruction_cycles[opcode];
+#define END_OP }
+#define OP_BAIL return
+#define OPERAND_BYTE ((uint8_t) operand)
+#define OPERAND_ABS (*address += 2, operand)
+#define LOAD(a) load_byte(m, a)
+#define STORE(a, v) store_byte(m, a, v)
+#define WROTE(a, length) bytes_written(m, a, length)
+#define PUSH(v) push_byte(m, v, testing_mode)
+#define POP() pop_byte(m, testing_mode)
+#define SAVE_PROG() start_save(m)
+#define KEYBOARD_LINE() keyboard_line(m)
+#define WAIT_INPUT OP_BAIL // Never happens, the meta instructions are left to the threaded engine
+#include "instruction_bodies.c"
+#undef OP
+#undef END_OP
+#undef OP_BAIL
+#undef OPERAND_BYTE
+#undef OPERAND_ABS
+#undef LOAD
+#undef STORE
+#undef WROTE
+#undef PUSH
+#undef POP
+#undef SAVE_PROG
+#undef KEYBOARD_LINE
+#undef WAIT_INPUT
+
+// The meta instructions aren't here, so they're left to the interpreter
+void (*const jit_helpers[256])(struct machine *m, uint32_t operand) = {
+	[INS_BRK_IP] = jit_INS_BRK_IP, [INS_STA_ZP] = jit_INS_STA_ZP, [INS_STA_ZX] = jit_INS_STA_ZX,
+	[INS_STA_AB] = jit_INS_STA_AB, [INS_STA_AX] = jit_INS_STA_AX, [INS_STA_AY] = jit_INS_STA_AY,
+	[INS_STA_IX] = jit_INS_STA_IX, [INS_STA_IY] = jit_INS_STA_IY, [INS_RTI_IP] = jit_INS_RTI_IP,
+	[INS_STX_ZP] = jit_INS_STX_ZP, [INS_STX_ZY] = jit_INS_STX_ZY, [INS_STX_AB] = jit_INS_STX_AB,
+	[INS_STY_AB] = jit_INS_STY_AB, [INS_STY_ZP] = jit_INS_STY_ZP, [INS_STY_ZX] = jit_INS_STY_ZX,
+	[INS_TAX_IP] = jit_INS_TAX_IP, [INS_TAY_IP] = jit_INS_TAY_IP, [INS_TYA_IP] = jit_INS_TYA_IP,
+	[INS_TXA_IP] = jit_INS_TXA_IP, [INS_TSX_IP] = jit_INS_TSX_IP, [INS_TXS_IP] = jit_INS_TXS_IP,
+	[INS_DEC_ZP] = jit_INS_DEC_ZP, [INS_DEC_ZX] = jit_INS_DEC_ZX, [INS_DEC_AB] = jit_INS_DEC_AB,
+	[INS_DEC_AX] = jit_INS_DEC_AX, [INS_INC_ZP] = jit_INS_INC_ZP, [INS_INC_ZX] = jit_INS_INC_ZX,
+	[INS_INC_AB] = jit_INS_INC_AB, [INS_INC_AX] = jit_INS_INC_AX, [INS_DEX_IP] = jit_INS_DEX_IP,
+	[INS_INX_IP] = jit_INS_INX_IP, [INS_DEY_IP] = jit_INS_DEY_IP, [INS_INY_IP] = jit_INS_INY_IP,
+	[INS_ROL_AC] = jit_INS_ROL_AC, [INS_ROL_ZP] = jit_INS_ROL_ZP, [INS_ROL_ZX] = jit_INS_ROL_ZX,
+	[INS_ROL_AB] = jit_INS_ROL_AB, [INS_ROL_AX] = jit_INS_ROL_AX, [INS_ROR_AC] = jit_INS_ROR_AC,
+	[INS_ROR_ZP] = jit_INS_ROR_ZP, [INS_ROR_ZX] = jit_INS_ROR_ZX, [INS_ROR_AB] = jit_INS_ROR_AB,
+	[INS_ROR_AX] = jit_INS_ROR_AX, [INS_ASL_AC] = jit_INS_ASL_AC, [INS_ASL_ZP] = jit_INS_ASL_ZP,
+	[INS_ASL_ZX] = jit_INS_ASL_ZX, [INS_ASL_AB] = jit_INS_ASL_AB, [INS_ASL_AX] = jit_INS_ASL_AX,
+	[INS_LSR_AC] = jit_INS_LSR_AC, [INS_LSR_ZP] = jit_INS_LSR_ZP, [INS_LSR_ZX] = jit_INS_LSR_ZX,
+	[INS_LSR_AB] = jit_INS_LSR_AB, [INS_LSR_AX] = jit_INS_LSR_AX, [INS_CMP_IM] = jit_INS_CMP_IM,
+	[INS_CMP_ZP] = jit_INS_CMP_ZP, [INS_CMP_ZX] = jit_INS_CMP_ZX, [INS_CMP_AB] = jit_INS_CMP_AB,
+	[INS_CMP_AX] = jit_INS_CMP_AX, [INS_CMP_AY] = jit_INS_CMP_AY, [INS_CMP_IX] = jit_INS_CMP_IX,
+	[INS_CMP_IY] = jit_INS_CMP_IY, [INS_CPX_IM] = jit_INS_CPX_IM, [INS_CPX_ZP] = jit_INS_CPX_ZP,
+	[INS_CPX_AB] = jit_INS_CPX_AB, [INS_CPY_IM] = jit_INS_CPY_IM, [INS_CPY_ZP] = jit_INS_CPY_ZP,
+	[INS_CPY_AB] = jit_INS_CPY_AB, [INS_AND_IM] = jit_INS_AND_IM, [INS_AND_ZP] = jit_INS_AND_ZP,
+	[INS_AND_ZX] = jit_INS_AND_ZX, [INS_AND_AB] = jit_INS_AND_AB, [INS_AND_AX] = jit_INS_AND_AX,
+	[INS_AND_AY] = jit_INS_AND_AY, [INS_AND_IX] = jit_INS_AND_IX, [INS_AND_IY] = jit_INS_AND_IY,
+	[INS_EOR_IM] = jit_INS_EOR_IM, [INS_EOR_ZP] = jit_INS_EOR_ZP, [INS_EOR_ZX] = jit_INS_EOR_ZX,
+	[INS_EOR_AB] = jit_INS_EOR_AB, [INS_EOR_AX] = jit_INS_EOR_AX, [INS_EOR_AY] = jit_INS_EOR_AY,
+	[INS_EOR_IX] = jit_INS_EOR_IX, [INS_EOR_IY] = jit_INS_EOR_IY, [INS_ORA_IM] = jit_INS_ORA_IM,
+	[INS_ORA_ZP] = jit_INS_ORA_ZP, [INS_ORA_ZX] = jit_INS_ORA_ZX, [INS_ORA_AB] = jit_INS_ORA_AB,
+	[INS_ORA_AX] = jit_INS_ORA_AX, [INS_ORA_AY] = jit_INS_ORA_AY, [INS_ORA_IX] = jit_INS_ORA_IX,
+	[INS_ORA_IY] = jit_INS_ORA_IY, [INS_PHA_IP] = jit_INS_PHA_IP, [INS_PLA_IP] = jit_INS_PLA_IP,
+	[INS_PHP_IP] = jit_INS_PHP_IP, [INS_PLP_IP] = jit_INS_PLP_IP, [INS_BVS_RL] = jit_INS_BVS_RL,
+	[INS_BVC_RL] = jit_INS_BVC_RL, [INS_BCS_RL] = jit_INS_BCS_RL, [INS_BCC_RL] = jit_INS_BCC_RL,
+	[INS_BEQ_RL] = jit_INS_BEQ_RL, [INS_BMI_RL] = jit_INS_BMI_RL, [INS_BNE_RL] = jit_INS_BNE_RL,
+	[INS_BPL_RL] = jit_INS_BPL_RL, [INS_BIT_ZP] = jit_INS_BIT_ZP, [INS_BIT_AB] = jit_INS_BIT_AB,
+	[INS_ADC_IM] = jit_INS_ADC_IM, [INS_ADC_ZP] = jit_INS_ADC_ZP, [INS_ADC_ZX] = jit_INS_ADC_ZX,
+	[INS_ADC_AB] = jit_INS_ADC_AB, [INS_ADC_AX] = jit_INS_ADC_AX, [INS_ADC_AY] = jit_INS_ADC_AY,
+	[INS_ADC_IX] = jit_INS_ADC_IX, [INS_ADC_IY] = jit_INS_ADC_IY, [INS_SBC_IM] = jit_INS_SBC_IM,
+	[INS_SBC_ZP] = jit_INS_SBC_ZP, [INS_SBC_ZX] = jit_INS_SBC_ZX, [INS_SBC_AB] = jit_INS_SBC_AB,
+	[INS_SBC_AX] = jit_INS_SBC_AX, [INS_SBC_AY] = jit_INS_SBC_AY, [INS_SBC_IX] = jit_INS_SBC_IX,
+	[INS_SBC_IY] = jit_INS_SBC_IY, [INS_JMP_AB] = jit_INS_JMP_AB, [INS_JMP_ID] = jit_INS_JMP_ID,
+	[INS_JSR_AB] = jit_INS_JSR_AB, [INS_RTS_IP] = jit_INS_RTS_IP, [INS_LDX_IM] = jit_INS_LDX_IM,
+	[INS_LDX_ZP] = jit_INS_LDX_ZP, [INS_LDX_ZY] = jit_INS_LDX_ZY, [INS_LDX_AB] = jit_INS_LDX_AB,
+	[INS_LDX_AY] = jit_INS_LDX_AY, [INS_LDY_IM] = jit_INS_LDY_IM, [INS_LDY_ZP] = jit_INS_LDY_ZP,
+	[INS_LDY_ZX] = jit_INS_LDY_ZX, [INS_LDY_AB] = jit_INS_LDY_AB, [INS_LDY_AX] = jit_INS_LDY_AX,
+	[INS_LDA_IM] = jit_INS_LDA_IM, [INS_LDA_ZP] = jit_INS_LDA_ZP, [INS_LDA_ZX] = jit_INS_LDA_ZX,
+	[INS_LDA_AB] = jit_INS_LDA_AB, [INS_LDA_AX] = jit_INS_LDA_AX, [INS_LDA_AY] = jit_INS_LDA_AY,
+	[INS_LDA_IX] = jit_INS_LDA_IX, [INS_LDA_IY] = jit_INS_LDA_IY, [INS_CLD_IP] = jit_INS_CLD_IP,
+	[INS_SED_IP] = jit_INS_SED_IP, [INS_CLC_IP] = jit_INS_CLC_IP, [INS_SEC_IP] = jit_INS_SEC_IP,
+	[INS_CLI_IP] = jit_INS_CLI_IP, [INS_SEI_IP] = jit_INS_SEI_IP, [INS_CLV_IP] = jit_INS_CLV_IP,
+	[INS_NOP_IP] = jit_INS_NOP_IP,
+};
+
+void emit8(struct jit *j, uint8_t byte) {
+	j -> code[j -> used] = byte;
+	j -> used++;
+
+	return;
+}
+
+void emit32(struct jit *j, uint32_t value) {
+	memcpy(&j -> code[j -> used], &value, 4);
+	j -> used += 4;
+
+	return;
+}
+
+void emit64(struct jit *j, uint64_t value) {
+	memcpy(&j -> code[j -> used], &value, 8);
+	j -> used += 8;
+
+	return;
+}
+
+// Emits an opcode (up to 3 bytes, given as one number) followed by [rbx + offset]
+void emit_rbx(struct jit *j, uint32_t opcode, uint32_t offset) {
+	if (opcode > 0xFFFF) {
+		emit8(j, opcode >> 16);
+	}
+	if (opcode > 0xFF) {
+		emit8(j, opcode >> 8);
+	}
+	emit8(j, opcode);
+	emit32(j, offset);
+
+	return;
+}
+
+// Points a rel32 at "to"
+void patch_rel32(uint8_t *rel, uint8_t *to) {
+	int32_t distance = (int32_t) (to - (rel + 4));
+	memcpy(rel, &distance, 4);
+
+	return;
+}
+
+// Throws away all of the compiled code
+void flush_jit(struct machine *m) {
+	struct jit *j = m -> jit;
+
+	j -> used = 0;
+	j -> block_count = 0;
+	j -> flushes++;
+	memset(j -> lookup, 0, sizeof(j -> lookup));
+	memset(j -> compiled, 0, (MAX_MEM + 1) / 8);
+	for (uint32_t i = 0; i <= PAGE_COUNT; i++) {
+		m -> page_flags[i] &= ~PAGE_JIT;
+	}
+	m -> jit_flush = 0;
+
+	return;
+}
+
+// Returns 0 if the JIT can't be used (not enough memory)
+uint8_t start_jit(struct machine *m) {
+	if (m -> jit != NULL) {
+		return 1;
+	}
+	struct jit *j = (struct jit*) calloc(1, sizeof(struct jit));
+	if (j == NULL) {
+		perror("Failed to allocate memory for the JIT");
+		return 0;
+	}
+	j -> code = (uint8_t*) mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	j -> compiled = (uint8_t*) calloc((MAX_MEM + 1) / 8, 1);
+	if (j -> code == MAP_FAILED || j -> compiled == NULL) {
+		perror("Failed to allocate memory for the JIT");
+		if (j -> code != MAP_FAILED) {
+			munmap(j -> code, JIT_CODE_SIZE);
+		}
+		free(j -> compiled);
+		free(j);
+		return 0;
+	}
+	m -> jit = j;
+
+	// The compiler decides where bitfields go, so find out
+	struct data probe;
+#define FLAG_MASK(flag) (memset(&probe, 0, sizeof(probe)), probe.flag = 1, *(uint8_t*) &probe)
+	j -> flag_i = FLAG_MASK(I);
+	j -> flag_d = FLAG_MASK(D);
+	j -> flag_b = FLAG_MASK(B);
+#if LAZY_FLAGS
+	j -> flag_c = (struct jit_flag) {AT(data.c_result), 0b00000001, 0};
+	j -> flag_z = (struct jit_flag) {AT(data.z_result), 0b11111111, 1};
+	j -> flag_v = (struct jit_flag) {AT(data.v_result), 0b10000000, 0};
+	j -> flag_n = (struct jit_flag) {AT(data.n_result), 0b10000000, 0};
+#else
+	j -> flag_c = (struct jit_flag) {AT(data), FLAG_MASK(C), 0};
+	j -> flag_z = (struct jit_flag) {AT(data), FLAG_MASK(Z), 0};
+	j -> flag_v = (struct jit_flag) {AT(data), FLAG_MASK(V), 0};
+	j -> flag_n = (struct jit_flag) {AT(data), FLAG_MASK(N), 0};
+#endif
+#undef FLAG_MASK
+
+	return 1;
+}
+
+void free_jit(struct machine *m) {
+	if (m -> jit == NULL) {
+		return;
+	}
+	munmap(m -> jit -> code, JIT_CODE_SIZE);
+	free(m -> jit -> compiled);
+	free(m -> jit);
+	m -> jit = NULL;
+
+	return;
+}
+
+// Called when a PAGE_JIT page gets written to
+void jit_written(struct machine *m, uint32_t address) {
+	if (m -> jit != NULL && address <= MAX_MEM && (m -> jit -> compiled[address >> 3] & (1 << (address & 7)))) {
+		m -> jit_flush = 1;
+		m -> jit_exit = 1;
+	}
+
+	return;
+}
+
+/*
+Leaves the block in the middle, after the "count"th instruction, if something set
+jit_exit (the program wrote over compiled code, or to the watched I/O address)
+*/
+void emit_exit_check(struct jit *j, uint32_t next, uint32_t count) {
+	emit_rbx(j, 0x80BB, AT(jit_exit)); // cmp byte [rbx + jit_exit], 0
+	emit8(j, 0);
+	emit8(j, 0x74); // je over the rest
+	emit8(j, 33);
+	emit_rbx(j, 0xC783, AT(data.PC)); // mov dword [rbx + PC], next
+	emit32(j, next);
+	emit_rbx(j, 0x8183, AT(jit_done)); // add dword [rbx + jit_done], count
+	emit32(j, count);
+	emit_rbx(j, 0x48C783, AT(jit_last)); // mov qword [rbx + jit_last], 0
+	emit32(j, 0);
+	emit8(j, 0x5B); // pop rbx
+	emit8(j, 0xC3); // ret
+
+	return;
+}
+
+// How a block ended, for end_block()
+#define END_NONE 0 // It just got to an instruction it couldn't do (or the size limit)
+#define END_BODY 1 // With a call to a body, which left PC on the last byte like always
+#define END_NATIVE 2 // With a jump or branch that's already set PC
+
+// Emits [rbx + offset] instructions with an 8 bit immediate on the end
+void emit_rbx8(struct jit *j, uint32_t opcode, uint32_t offset, uint8_t value) {
+	emit_rbx(j, opcode, offset);
+	emit8(j, value);
+
+	return;
+}
+
+// Adds the cycles for the instructions since the last time this was done
+void emit_cycles(struct jit *j, uint32_t *cycles) {
+	if (*cycles > 0) {
+		emit_rbx(j, 0x488183, AT(data.cyclenum)); // add qword [rbx + cyclenum], cycles
+		emit32(j, *cycles);
+		*cycles = 0;
+	}
+
+	return;
+}
+
+// Sets a bit of the flags byte to bit 7 of al
+void emit_bit7(struct jit *j, uint8_t bit) {
+	emit_rbx8(j, 0x80A3, AT(data), ~bit); // and byte [rbx + flags], ~bit
+	emit8(j, 0xA8); // test al, 0b10000000
+	emit8(j, 0x80);
+	emit8(j, 0x74); // jz over the next one
+	emit8(j, 7);
+	emit_rbx8(j, 0x808B, AT(data), bit); // or byte [rbx + flags], bit
+
+	return;
+}
+
+/*
+Sets Z from al being 0 and N from bit 7 of it, or B instead of N for the
+INX/DEX/INY/DEY quirk.
+*/
+void emit_zero_negative(struct jit *j, uint8_t b_not_n) {
+#if LAZY_FLAGS
+	emit_rbx(j, 0x8883, AT(data.z_result)); // mov byte [rbx + z_result], al
+	if (!b_not_n) {
+		emit_rbx(j, 0x8883, AT(data.n_result)); // mov byte [rbx + n_result], al
+		return;
+	}
+#else
+	emit_rbx8(j, 0x80A3, AT(data), ~j -> flag_z.mask); // and byte [rbx + flags], ~Z
+	emit8(j, 0x84); // test al, al
+	emit8(j, 0xC0);
+	emit8(j, 0x75); // jnz over the next one
+	emit8(j, 7);
+	emit_rbx8(j, 0x808B, AT(data), j -> flag_z.mask); // or byte [rbx + flags], Z
+	if (!b_not_n) {
+		emit_bit7(j, j -> flag_n.mask);
+		return;
+	}
+#endif
+	emit_bit7(j, j -> flag_b);
+
+	return;
+}
+
+/*
+The simplest instructions get turned straight into x86 instead of calling their
+bodies (these have to do exactly what their bodies in instruction_bodies.c do,
+quirks and all). Returns 0 if it isn't one of them. All of these take 2 cycles,
+which get added up and added on in one go.
+*/
+uint8_t emit_native(struct jit *j, uint8_t opcode, uint32_t operand) {
+	uint32_t from = 0, to = 0;
+	uint8_t flags = 1, b_not_n = 0;
+
+	switch (opcode) {
+		case INS_LDA_IM: to = AT(data.A); break;
+		case INS_LDX_IM: to = AT(data.X); break;
+		case INS_LDY_IM: to = AT(data.Y); break;
+		case INS_TAX_IP: from = AT(data.A); to = AT(data.X); break;
+		case INS_TAY_IP: from = AT(data.A); to = AT(data.Y); break;
+		case INS_TYA_IP: from = AT(data.Y); to = AT(data.A); break;
+		case INS_TXA_IP: from = AT(data.X); to = AT(data.A); break;
+		case INS_TSX_IP: from = AT(data.SP); to = AT(data.X); break;
+		case INS_TXS_IP: from = AT(data.X); to = AT(data.SP); flags = 0; break;
+		// These set B rather than N
+		case INS_INX_IP: to = AT(data.X); b_not_n = 1; emit_rbx(j, 0xFE83, to); break; // inc byte [rbx + X]
+		case INS_DEX_IP: to = AT(data.X); b_not_n = 1; emit_rbx(j, 0xFE8B, to); break; // dec byte [rbx + X]
+		case INS_INY_IP: to = AT(data.Y); b_not_n = 1; emit_rbx(j, 0xFE83, to); break;
+		case INS_DEY_IP: to = AT(data.Y); b_not_n = 1; emit_rbx(j, 0xFE8B, to); break;
+		case INS_CLD_IP: emit_rbx8(j, 0x80A3, AT(data), ~j -> flag_d); return 1;
+		case INS_CLI_IP: emit_rbx8(j, 0x80A3, AT(data), ~j -> flag_i); return 1;
+#if LAZY_FLAGS
+		case INS_CLC_IP: emit_rbx8(j, 0xC683, AT(data.c_result), 0); return 1; // mov byte [rbx + c_result], 0
+		case INS_SEC_IP: emit_rbx8(j, 0xC683, AT(data.c_result), 1); return 1;
+		case INS_CLV_IP: emit_rbx8(j, 0xC683, AT(data.v_result), 0); return 1;
+#else
+		case INS_CLC_IP: emit_rbx8(j, 0x80A3, AT(data), ~j -> flag_c.mask); return 1; // and byte [rbx + flags], ~C
+		case INS_SEC_IP: emit_rbx8(j, 0x808B, AT(data), j -> flag_c.mask); return 1; // or byte [rbx + flags], C
+		case INS_CLV_IP: emit_rbx8(j, 0x80A3, AT(data), ~j -> flag_v.mask); return 1;
+#endif
+		case INS_SED_IP: emit_rbx8(j, 0x808B, AT(data), j -> flag_d); return 1;
+		case INS_SEI_IP: emit_rbx8(j, 0x808B, AT(data), j -> flag_i); return 1;
+		case INS_NOP_IP: return 1;
+		default: return 0;
+	}
+
+	if (opcode == INS_LDA_IM || opcode == INS_LDX_IM || opcode == INS_LDY_IM) {
+		// The value's known now, so the flags are too
+		emit_rbx8(j, 0xC683, to, operand); // mov byte [rbx + to], operand
+#if LAZY_FLAGS
+		emit_rbx8(j, 0xC683, AT(data.z_result), operand); // mov byte [rbx + z_result], operand
+		emit_rbx8(j, 0xC683, AT(data.n_result), operand); // mov byte [rbx + n_result], operand
+#else
+		emit_rbx8(j, 0x80A3, AT(data), ~(j -> flag_z.mask | j -> flag_n.mask)); // and byte [rbx + flags], ~(Z | N)
+		emit_rbx8(j, 0x808B, AT(data), ((operand & 0xFF) == 0 ? j -> flag_z.mask : 0) | ((operand & 0b10000000) ? j -> flag_n.mask : 0));
+#endif
+		return 1;
+	}
+	if (from != 0) {
+		emit_rbx(j, 0x0FB683, from); // movzx eax, byte [rbx + from]
+		emit_rbx(j, 0x8883, to); // mov byte [rbx + to], al
+	} else {
+		emit_rbx(j, 0x0FB683, to); // movzx eax, byte [rbx + to]
+	}
+	if (flags) {
+		emit_zero_negative(j, b_not_n);
+	}
+
+	return 1;
+}
+
+/*
+Branches and JMP_AB. Where they go is known now, so they set PC themselves (and end
+the block). Returns 0 if it isn't one of them.
+*/
+uint8_t emit_jump(struct jit *j, uint8_t opcode, uint32_t address, uint32_t operand) {
+	uint32_t target = branch_target(opcode, address, operand);
+	struct jit_flag flag;
+	uint8_t branch_if_set;
+
+	switch (opcode) {
+		case INS_JMP_AB:
+			emit_rbx(j, 0xC783, AT(data.PC)); // mov dword [rbx + PC], operand
+			emit32(j, operand);
+			emit_rbx(j, 0x488183, AT(data.cyclenum)); // add qword [rbx + cyclenum], cycles
+			emit32(j, instruction_cycles[opcode]);
+			return 1;
+		case INS_BVS_RL: flag = j -> flag_v; branch_if_set = 1; break;
+		case INS_BVC_RL: flag = j -> flag_v; branch_if_set = 0; break;
+		case INS_BCS_RL: flag = j -> flag_c; branch_if_set = 1; break;
+		case INS_BCC_RL: flag = j -> flag_c; branch_if_set = 0; break;
+		case INS_BEQ_RL: flag = j -> flag_z; branch_if_set = 1; break;
+		case INS_BMI_RL: flag = j -> flag_n; branch_if_set = 1; break;
+		case INS_BNE_RL: flag = j -> flag_z; branch_if_set = 0; break;
+		case INS_BPL_RL: flag = j -> flag_n; branch_if_set = 0; break;
+		default: return 0;
+	}
+
+	emit_rbx8(j, 0xF683, flag.offset, flag.mask); // test byte [rbx + offset], mask
+	emit8(j, 0x0F); // jz/jnz to not taken
+	emit8(j, (branch_if_set ^ flag.inverted) ? 0x84 : 0x85);
+	emit32(j, 26);
+	emit_rbx(j, 0xC783, AT(data.PC)); // mov dword [rbx + PC], target
+	emit32(j, target);
+	emit_rbx(j, 0x488183, AT(data.cyclenum)); // add qword [rbx + cyclenum], cycles when taken
+	emit32(j, instruction_cycles[opcode] + 1 + PAGE_CROSSED(address + 2, target));
+	emit8(j, 0xE9); // jmp past not taken
+	emit32(j, 21);
+	emit_rbx(j, 0xC783, AT(data.PC)); // not taken: mov dword [rbx + PC], address + 2
+	emit32(j, address + 2);
+	emit_rbx(j, 0x488183, AT(data.cyclenum)); // add qword [rbx + cyclenum], cycles
+	emit32(j, instruction_cycles[opcode]);
+
+	return 1;
+}
+
+/*
+The end of a block: sets PC, counts the instructions, then has two chain slots. A
+slot checks if PC is the address it's been pointed at, and if it is (and there's
+still budget left) jumps straight into that block. They start off pointed nowhere
+(and jumping to the end), run_jit() points them at blocks as it finds out where
+this one goes.
+*/
+void end_block(struct jit *j, struct jit_block *block, uint32_t next, uint32_t count, uint8_t ended, uint8_t check_exit) {
+	uint8_t *leave;
+
+	if (ended == END_BODY) {
+		emit_rbx(j, 0xFF83, AT(data.PC)); // inc dword [rbx + PC] (the body left it on the last byte)
+	} else if (ended == END_NONE) {
+		emit_rbx(j, 0xC783, AT(data.PC)); // mov dword [rbx + PC], next
+		emit32(j, next);
+	}
+	emit_rbx(j, 0x8183, AT(jit_done)); // add dword [rbx + jit_done], count
+	emit32(j, count);
+
+	// Where the slots end, and the block gets left
+	leave = &j -> code[j -> used] + 2 * SLOT_SIZE + (check_exit ? 13 : 0);
+	if (check_exit) {
+		emit_rbx(j, 0x80BB, AT(jit_exit)); // cmp byte [rbx + jit_exit], 0
+		emit8(j, 0);
+		emit8(j, 0x0F); // jne leave
+		emit8(j, 0x85);
+		emit32(j, 0);
+		patch_rel32(&j -> code[j -> used - 4], leave);
+	}
+
+	block -> slots = &j -> code[j -> used];
+	block -> slots_used = 0;
+	for (uint8_t i = 0; i < 2; i++) {
+		uint8_t *slot = &j -> code[j -> used];
+
+		emit_rbx(j, 0x81BB, AT(data.PC)); // cmp dword [rbx + PC], address
+		emit32(j, 0xFFFFFFFF);
+		emit8(j, 0x0F); // jne to the next slot
+		emit8(j, 0x85);
+		emit32(j, 0);
+		patch_rel32(&j -> code[j -> used - 4], slot + SLOT_SIZE);
+		emit_rbx(j, 0x8B83, AT(jit_done)); // mov eax, [rbx + jit_done]
+		emit_rbx(j, 0x3B83, AT(jit_done_limit)); // cmp eax, [rbx + jit_done_limit]
+		emit8(j, 0x0F); // jae leave
+		emit8(j, 0x83);
+		emit32(j, 0);
+		patch_rel32(&j -> code[j -> used - 4], leave);
+		emit_rbx(j, 0x488B83, AT(data.cyclenum)); // mov rax, [rbx + cyclenum]
+		emit_rbx(j, 0x483B83, AT(run_end)); // cmp rax, [rbx + run_end]
+		emit8(j, 0x0F); // jae leave
+		emit8(j, 0x83);
+		emit32(j, 0);
+		patch_rel32(&j -> code[j -> used - 4], leave);
+		emit8(j, 0xE9); // jmp to the other block (leave for now)
+		emit32(j, 0);
+		patch_rel32(&j -> code[j -> used - 4], leave);
+	}
+
+	emit8(j, 0x48); // mov rax, block
+	emit8(j, 0xB8);
+	emit64(j, (uint64_t) block);
+	emit_rbx(j, 0x488983, AT(jit_last)); // mov [rbx + jit_last], rax
+	emit8(j, 0x5B); // pop rbx
+	emit8(j, 0xC3); // ret
+
+	return;
+}
+
+// Returns NULL if the instruction at address can't be compiled
+struct jit_block *compile_block(struct machine *m, uint32_t address) {
+	struct jit *j = m -> jit;
+	uint8_t *mem = m -> mem;
+	struct jit_block *block;
+	uint32_t count = 0;
+	uint32_t cycles = 0; // From native instructions, not added on yet
+	uint8_t ended = END_NONE;
+	uint8_t check_exit = 0;
+
+	if (address > MAX_MEM || jit_helpers[mem[address]] == NULL) {
+		return NULL;
+	}
+	if (j -> used + JIT_BLOCK_BYTES > JIT_CODE_SIZE || j -> block_count >= JIT_MAX_BLOCKS) {
+		flush_jit(m);
+	}
+
+	block = &j -> blocks[j -> block_count];
+	j -> block_count++;
+	block -> address = address;
+	block -> entry = &j -> code[j -> used];
+	emit8(j, 0x53); // push rbx
+	emit8(j, 0x48); // mov rbx, rdi
+	emit8(j, 0x89);
+	emit8(j, 0xFB);
+	block -> body = &j -> code[j -> used];
+
+	while (count < JIT_MAX_BLOCK && address <= MAX_MEM) {
+		uint8_t opcode = mem[address];
+		uint8_t length = (instruction_length[opcode] == 0) ? 1 : instruction_length[opcode];
+		uint32_t operand = 0;
+
+		if (jit_helpers[opcode] == NULL || address + length - 1 > MAX_MEM) {
+			break;
+		}
+		if (length >= 2) {
+			operand = mem[address + 1];
+		}
+		if (length == 4) {
+			operand |= (mem[address + 2] << 8) | (mem[address + 3] << 16);
+		}
+
+		for (uint32_t i = address; i < address + length; i++) {
+			j -> compiled[i >> 3] |= 1 << (i & 7);
+			m -> page_flags[i >> PAGE_SHIFT] |= PAGE_JIT;
+		}
+		count++;
+
+		if (emit_native(j, opcode, operand)) {
+			cycles += instruction_cycles[opcode];
+			check_exit = 0;
+			address += length;
+			continue;
+		}
+		emit_cycles(j, &cycles);
+		if (emit_jump(j, opcode, address, operand)) {
+			check_exit = 0;
+			ended = END_NATIVE;
+			break;
+		}
+
+		emit_rbx(j, 0xC783, AT(data.PC)); // mov dword [rbx + PC], address
+		emit32(j, address);
+		emit8(j, 0x48); // mov rdi, rbx
+		emit8(j, 0x89);
+		emit8(j, 0xDF);
+		emit8(j, 0xBE); // mov esi, operand
+		emit32(j, operand);
+		emit8(j, 0x48); // mov rax, the body
+		emit8(j, 0xB8);
+		emit64(j, (uint64_t) jit_helpers[opcode]);
+		emit8(j, 0xFF); // call rax
+		emit8(j, 0xD0);
+		address += length;
+
+		check_exit = writes_memory[opcode] || ends_block[opcode];
+		if (ends_block[opcode]) {
+			ended = END_BODY;
+			break;
+		}
+		if (check_exit && count < JIT_MAX_BLOCK) {
+			emit_exit_check(j, address, count);
+		}
+	}
+	emit_cycles(j, &cycles);
+	end_block(j, block, address, count, ended, check_exit);
+
+	j -> lookup[block -> address & JIT_LOOKUP_MASK] = block;
+
+	return block;
+}
+
+struct jit_block *find_block(struct machine *m, uint32_t address) {
+	struct jit_block *block = m -> jit -> lookup[address & JIT_LOOKUP_MASK];
+
+	if (block != NULL && block -> address == address) {
+		return block;
+	}
+
+	return compile_block(m, address);
+}
+
+// Points one of from's chain slots at the block for wherever the program is now
+void chain_block(struct machine *m, struct jit_block *from) {
+	uint32_t flushes = m -> jit -> flushes;
+	struct jit_block *to;
+	uint8_t *slot;
+
+	if (from -> slots_used >= 2) {
+		return;
+	}
+	to = find_block(m, m -> data.PC);
+	// Compiling it might have thrown "from" away
+	if (to == NULL || m -> jit -> flushes != flushes) {
+		return;
+	}
+	slot = from -> slots + from -> slots_used * SLOT_SIZE;
+	from -> slots_used++;
+	memcpy(slot + SLOT_ADDRESS, &to -> address, 4);
+	patch_rel32(slot + SLOT_JUMP, to -> body);
+
+	return;
+}
+
+uint8_t run_jit(RUN_ARGS) {
+	struct data *data = &m -> data;
+	uint8_t *mem = m -> mem;
+	uint32_t stepped = 0; // Instructions the threaded engine ran (it counts those itself)
+	uint8_t reason = STOP_BUDGET;
+	uint8_t (*run_threaded)(RUN_ARGS) = (m -> testing_mode == 0) ? run_threaded_0 : run_threaded_traced;
+
+	// Tracing, breakpoints and conditions have to see every instruction
+	if (m -> testing_mode > 0 || m -> breakpoint_count > 0 || condition != NULL || !start_jit(m)) {
+		return run_threaded(m, count, condition, ctx);
+	}
+
+	m -> jit_done = 0;
+	m -> jit_done_limit = (count > JIT_MAX_BLOCK) ? count - JIT_MAX_BLOCK : 0;
+
+	while (1) {
+		struct jit_block *block = NULL;
+
+		// Before looking at irq, so one that's raised after this still gets the compiled code out
+		m -> jit_exit = 0;
+		// Anything that came in while it wasn't running (like an event going off, see events.c)
+		if (INTERRUPT_PENDING(m)) {
+			take_irq(m);
+		}
+		if (m -> jit_flush) {
+			flush_jit(m);
+		}
+		// Near the end of an instruction budget, go one at a time so it doesn't go over
+		if (count - m -> jit_done >= JIT_MAX_BLOCK) {
+			block = find_block(m, data -> PC);
+		}
+
+		if (block == NULL) {
+			reason = run_threaded(m, 1, NULL, NULL);
+			m -> jit_done++;
+			stepped++;
+			if (reason != STOP_BUDGET) {
+				break;
+			}
+		} else {
+			m -> jit_last = NULL;
+			((void (*)(struct machine *m)) block -> entry)(m);
+
+			if (INTERRUPT_PENDING(m)) {
+				take_irq(m);
+			}
+			if (m -> io_watching && mem[m -> io_watch] != m -> io_last) {
+				m -> io_last = mem[m -> io_watch];
+				reason = STOP_IO;
+				break;
+			}
+		}
+
+		if (m -> jit_done >= count || data -> cyclenum >= m -> run_end) {
+			reason = STOP_BUDGET;
+			break;
+		}
+		if (block != NULL && m -> jit_last != NULL && !m -> jit_flush) {
+			chain_block(m, m -> jit_last);
+		}
+	}
+	data -> instructions += m -> jit_done - stepped;
+
+	return reason;
+}
+
+#else
+
+uint8_t run_jit(RUN_ARGS) {
+	if (m -> testing_mode == 0) {
+		return run_threaded_0(m, count, condition, ctx);
+	}
+
+	return run_threaded_traced(m, count, condition, ctx);
+}
+
+void jit_written(struct machine *m, uint32_t address) {
+	return;
+}
+
+void free_jit(struct machine *m) {
+	return;
+}
+
+#endif
@@ -0,0 +1,303 @@
+/*******************************************************
+
+The keyboard: input that doesn't stop everything.
+
+MTA_KYB_IP used to just call fgets(), so the whole
+machine (and the host, which was stuck inside execute())
+sat there until a line came in. On real hardware the
+keyboard would interrupt the CPU when something got
+typed, and that's what this does.
+
+add_keyboard() starts a thread that reads the host's
+input (a file descriptor, normally stdin) as it comes in
+and puts it in a ring buffer, and puts 3 registers on the
+bus at start:
+	start + 0 (KEYBOARD_STATUS, read only): KEYBOARD_...
+		bits for what's in the buffer
+	start + 1 (KEYBOARD_DATA, read only): takes the next
+		byte out of the buffer (0 if it's empty)
+	start + 2 (KEYBOARD_CONTROL, write only): writing
+		KEYBOARD_INTERRUPTS turns interrupts on (writing
+		it without turns them off), writing
+		KEYBOARD_OVERFLOWED clears that
+With interrupts on the keyboard holds the IRQ line (see
+interrupts.c) for as long as there's anything in the
+buffer, so the interrupt routine just has to read
+KEYBOARD_DATA until it's empty. Interrupts start out off.
+
+Programs that don't know about any of that (Sigma OS)
+still use MTA_KYB_IP, which gets its lines out of the same
+buffer once there's a keyboard. If there isn't a whole
+line in it yet, the run stops with STOP_WAITING instead of
+waiting (the MTA_KYB_IP hasn't run yet, it runs again next
+time), and the host can do something else or wait for it
+with wait_keyboard(), which sleeps until there's a line
+instead of spinning.
+
+The buffer's only got one thread putting things in and
+one (the machine's) taking them out, so it doesn't need a
+lock, just the head and tail being read and written
+atomically. If the program doesn't keep up and it fills
+up, anything else that gets typed is thrown away and
+KEYBOARD_OVERFLOWED gets set.
+
+*******************************************************/
+
+#include <pthread.h>
+#include <errno.h>
+
+#define KEYBOARD_BUFFER 4096 // Has to be a power of 2
+#define KEYBOARD_MASK (KEYBOARD_BUFFER - 1)
+#define KEYBOARD_LINE_LENGTH 250 // How much MTA_KYB_IP can put at keyboard_addr, like fgets() had
+
+// The registers, from start
+#define KEYBOARD_STATUS 0
+#define KEYBOARD_DATA 1
+#define KEYBOARD_CONTROL 2
+
+// What KEYBOARD_STATUS says
+#define KEYBOARD_READY 0b00000001 // There's something in the buffer
+#define KEYBOARD_WHOLE_LINE 0b00000010 // There's a whole line in it
+#define KEYBOARD_OVERFLOWED 0b00000100 // Something got thrown away because it was full
+#define KEYBOARD_ENDED 0b00001000 // The input's finished, there won't be any more
+#define KEYBOARD_INTERRUPTS 0b10000000 // Interrupts are on
+
+struct keyboard {
+	struct machine *m;
+	uint32_t start;
+	uint8_t source; // Its bit on the IRQ line
+	int fd;
+
+	uint8_t buffer[KEYBOARD_BUFFER];
+	uint32_t head; // Where the next byte goes (only the thread moves it)
+	uint32_t tail; // Where the next byte comes out (only the machine moves it)
+	uint8_t overflowed;
+	uint8_t ended;
+	uint8_t interrupts;
+
+	pthread_t thread;
+	pthread_mutex_t lock; // Just for sleeping in wait_keyboard()
+	pthread_cond_t arrived;
+};
+
+uint32_t keyboard_count(struct keyboard *keyboard) {
+	return __atomic_load_n(&keyboard -> head, __ATOMIC_SEQ_CST) - keyboard -> tail;
+}
+
+/*
+Returns how many bytes MTA_KYB_IP would take for its line (up to the newline, or as much
+as fits), or 0 if there isn't a whole one yet.
+*/
+uint32_t keyboard_line_length(struct keyboard *keyboard) {
+	uint32_t count = keyboard_count(keyboard);
+	uint32_t most = (count < KEYBOARD_LINE_LENGTH - 1) ? count : KEYBOARD_LINE_LENGTH - 1;
+
+	for (uint32_t i = 0; i < most; i++) {
+		if (keyboard -> buffer[(keyboard -> tail + i) & KEYBOARD_MASK] == '\n') {
+			return i + 1;
+		}
+	}
+	// Same as fgets(), a long line comes in bits and the last one doesn't need a newline
+	if (most == KEYBOARD_LINE_LENGTH - 1 || __atomic_load_n(&keyboard -> ended, __ATOMIC_ACQUIRE)) {
+		return most;
+	}
+
+	return 0;
+}
+
+// Holds the IRQ line if interrupts are on and there's something to read, lets go of it otherwise
+void keyboard_irq(struct keyboard *keyboard) {
+	lower_irq(keyboard -> m, keyboard -> source);
+	// The thread might have just added something, but then it raises it again itself
+	if (__atomic_load_n(&keyboard -> interrupts, __ATOMIC_SEQ_CST) && keyboard_count(keyboard) > 0) {
+		raise_irq(keyboard -> m, keyboard -> source);
+	}
+
+	return;
+}
+
+void keyboard_signal(struct keyboard *keyboard) {
+	int old_state;
+
+	// It can't be cancelled while it's got the lock, wait_keyboard() would never get it back
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_state);
+	pthread_mutex_lock(&keyboard -> lock);
+	pthread_cond_broadcast(&keyboard -> arrived);
+	pthread_mutex_unlock(&keyboard -> lock);
+	pthread_setcancelstate(old_state, NULL);
+
+	return;
+}
+
+void *keyboard_thread(void *arg) {
+	struct keyboard *keyboard = (struct keyboard*) arg;
+	uint8_t bytes[256];
+
+	while (1) {
+		ssize_t got = read(keyboard -> fd, bytes, sizeof(bytes));
+		if (got < 0 && errno == EINTR) {
+			continue;
+		}
+		if (got <= 0) {
+			break;
+		}
+
+		uint32_t head = keyboard -> head;
+		uint32_t tail = __atomic_load_n(&keyboard -> tail, __ATOMIC_ACQUIRE);
+		for (ssize_t i = 0; i < got; i++) {
+			if (head - tail == KEYBOARD_BUFFER) {
+				__atomic_store_n(&keyboard -> overflowed, 1, __ATOMIC_RELAXED);
+				break;
+			}
+			keyboard -> buffer[head & KEYBOARD_MASK] = bytes[i];
+			head++;
+		}
+		__atomic_store_n(&keyboard -> head, head, __ATOMIC_SEQ_CST);
+
+		if (__atomic_load_n(&keyboard -> interrupts, __ATOMIC_SEQ_CST)) {
+			raise_irq(keyboard -> m, keyboard -> source);
+		}
+		keyboard_signal(keyboard);
+	}
+
+	__atomic_store_n(&keyboard -> ended, 1, __ATOMIC_RELEASE);
+	keyboard_signal(keyboard);
+
+	return NULL;
+}
+
+uint8_t keyboard_read(struct machine *m, void *ctx, uint32_t address) {
+	struct keyboard *keyboard = (struct keyboard*) ctx;
+	uint8_t value = 0;
+
+	switch (address - keyboard -> start) {
+		case KEYBOARD_STATUS:
+			if (keyboard_count(keyboard) > 0) {
+				value |= KEYBOARD_READY;
+			}
+			if (keyboard_line_length(keyboard) > 0) {
+				value |= KEYBOARD_WHOLE_LINE;
+			}
+			if (__atomic_load_n(&keyboard -> overflowed, __ATOMIC_RELAXED)) {
+				value |= KEYBOARD_OVERFLOWED;
+			}
+			if (__atomic_load_n(&keyboard -> ended, __ATOMIC_ACQUIRE)) {
+				value |= KEYBOARD_ENDED;
+			}
+			if (keyboard -> interrupts) {
+				value |= KEYBOARD_INTERRUPTS;
+			}
+			break;
+		case KEYBOARD_DATA:
+			if (keyboard_count(keyboard) > 0) {
+				value = keyboard -> buffer[keyboard -> tail & KEYBOARD_MASK];
+				__atomic_store_n(&keyboard -> tail, keyboard -> tail + 1, __ATOMIC_RELEASE);
+				keyboard_irq(keyboard);
+			}
+			break;
+	}
+
+	return value;
+}
+
+void keyboard_write(struct machine *m, void *ctx, uint32_t address, uint8_t value) {
+	struct keyboard *keyboard = (struct keyboard*) ctx;
+
+	if (address - keyboard -> start != KEYBOARD_CONTROL) {
+		return;
+	}
+	__atomic_store_n(&keyboard -> interrupts, (value & KEYBOARD_INTERRUPTS) != 0, __ATOMIC_SEQ_CST);
+	if (value & KEYBOARD_OVERFLOWED) {
+		__atomic_store_n(&keyboard -> overflowed, 0, __ATOMIC_RELAXED);
+	}
+	keyboard_irq(keyboard);
+
+	return;
+}
+
+/*
+Called by MTA_KYB_IP. Puts the next line at keyboard_addr like fgets() would (with a 0
+after it) and returns 1, or returns 0 if there isn't a whole line yet. Without a keyboard
+it's just fgets().
+*/
+uint8_t keyboard_line(struct machine *m) {
+	struct keyboard *keyboard = m -> keyboard;
+
+	if (keyboard == NULL) {
+		fgets((char*) m -> keyboard_addr, KEYBOARD_LINE_LENGTH, stdin);
+		return 1;
+	}
+
+	uint32_t length = keyboard_line_length(keyboard);
+	if (length == 0) {
+		// Once it's ended there's never going to be one, and fgets() leaves it alone then
+		return __atomic_load_n(&keyboard -> ended, __ATOMIC_ACQUIRE) && keyboard_count(keyboard) == 0;
+	}
+	for (uint32_t i = 0; i < length; i++) {
+		m -> keyboard_addr[i] = keyboard -> buffer[(keyboard -> tail + i) & KEYBOARD_MASK];
+	}
+	m -> keyboard_addr[length] = 0;
+	__atomic_store_n(&keyboard -> tail, keyboard -> tail + length, __ATOMIC_RELEASE);
+	keyboard_irq(keyboard);
+
+	return 1;
+}
+
+/*
+Sleeps until MTA_KYB_IP has a whole line to take (or the input's ended), for when a run
+stops with STOP_WAITING. Returns 0 if the input's ended and there's nothing left in it.
+*/
+uint8_t wait_keyboard(struct keyboard *keyboard) {
+	pthread_mutex_lock(&keyboard -> lock);
+	while (keyboard_line_length(keyboard) == 0 && !__atomic_load_n(&keyboard -> ended, __ATOMIC_ACQUIRE)) {
+		pthread_cond_wait(&keyboard -> arrived, &keyboard -> lock);
+	}
+	pthread_mutex_unlock(&keyboard -> lock);
+
+	return keyboard_count(keyboard) > 0;
+}
+
+/*
+Puts a keyboard reading from fd on the bus at start (to start + 2), interrupting on IRQ
+source "source" (0 to 30). It's where MTA_KYB_IP gets its lines from after this too.
+Returns 0 if it couldn't.
+*/
+uint8_t add_keyboard(struct machine *m, struct keyboard *keyboard, uint32_t start, int fd, uint8_t source) {
+	keyboard -> m = m;
+	keyboard -> start = start;
+	keyboard -> source = source;
+	keyboard -> fd = fd;
+	keyboard -> head = 0;
+	keyboard -> tail = 0;
+	keyboard -> overflowed = 0;
+	keyboard -> ended = 0;
+	keyboard -> interrupts = 0;
+
+	if (source >= IRQ_NMI || !add_device(m, start, start + KEYBOARD_CONTROL, keyboard_read, keyboard_write, keyboard)) {
+		return 0;
+	}
+	pthread_mutex_init(&keyboard -> lock, NULL);
+	pthread_cond_init(&keyboard -> arrived, NULL);
+	if (pthread_create(&keyboard -> thread, NULL, keyboard_thread, keyboard) != 0) {
+		m -> device_count--; // It was the last one added
+		pthread_mutex_destroy(&keyboard -> lock);
+		pthread_cond_destroy(&keyboard -> arrived);
+		return 0;
+	}
+	m -> keyboard = keyboard;
+
+	return 1;
+}
+
+// Stops the thread, once the machine isn't going to run again
+void free_keyboard(struct keyboard *keyboard) {
+	pthread_cancel(keyboard -> thread); // It's probably stuck in read()
+	pthread_join(keyboard -> thread, NULL);
+	pthread_mutex_destroy(&keyboard -> lock);
+	pthread_cond_destroy(&keyboard -> arrived);
+	if (keyboard -> m -> keyboard == keyboard) {
+		keyboard -> m -> keyboard = NULL;
+	}
+
+	return;
+}
@@ -0,0 +1,388 @@
+/*******************************************************
+
+A whole machine: the registers, the memory, and all the
+settings the host used to pass to execute() every time.
+Hosts set one of these up once with init_machine() and
+then hand it to run_for()/run_until() (see dispatch.c),
+which run lots of instructions without coming back to
+the host after every single one.
+
+*******************************************************/
+
+#include <string.h>
+#include <pthread.h>
+
+// Why run_for()/run_until()/run_steps() gave control back to the host
+#define STOP_BUDGET 0 // Ran out of cycles/instructions
+#define STOP_HALT 1 // The machine turned itself off (MTA_OFF_IP/MTA_OFS_IP)
+#define STOP_IO 2 // The watched I/O address changed
+#define STOP_BREAKPOINT 3 // Got to a breakpoint (it hasn't run yet)
+#define STOP_CONDITION 4 // run_until()'s condition came true
+#define STOP_MISMATCH 5 // The checked engine found the engines disagreeing
+#define STOP_WAITING 6 // MTA_KYB_IP is waiting for a line from the keyboard (see keyboard.c)
+
+#define MAX_BREAKPOINTS 16
+
+// Memory is split up into 4KB pages to keep track of what's in it
+#define PAGE_SHIFT 12
+#define PAGE_SIZE (1 << PAGE_SHIFT)
+#define PAGE_MASK (PAGE_SIZE - 1)
+#define PAGE_COUNT 4096 // (MAX_MEM + 1) / PAGE_SIZE, but MAX_MEM isn't a macro
+
+// What page_flags can say about a page
+#define PAGE_CODE 0b00000001 // Some of it has been predecoded, so writes have to tell the cache
+#define PAGE_JIT 0b00000010 // Some of it has been compiled by the JIT (see jit.c)
+#define PAGE_WATCHED 0b00000100 // The watched I/O address is in it
+#define PAGE_AOT 0b00001000 // Some of it has been translated ahead of time (see aot.c)
+#define PAGE_DEVICE 0b00010000 // A device has registers in it (see bus.c)
+#define PAGE_FORKED 0b00100000 // It's shared with a machine forked off this one (see fork.c)
+#define PAGE_CLEAN 0b01000000 // Nothing's written to it since the dirty pages were last cleared (see memory.c)
+#define PAGE_SAVED 0b10000000 // The save copy has what's in it (see save.c)
+
+#define MAX_DEVICES 16
+#define MAX_EVENTS 32
+#define IRQ_SOURCES 32 // Bits in m -> irq, the last one's the NMI (see interrupts.c)
+
+// One instruction in the predecode cache (see predecode.c)
+struct predecoded {
+	void *handler; // Where the threaded engine goes for it
+	void *next; // If it's the first half of a superinstruction, where the second half is
+	uint32_t address; // Which address is in this slot right now
+	uint32_t operand; // The byte after the opcode, or the 3 byte address
+	uint32_t next_operand; // The second half's operand
+	uint8_t length;
+	uint8_t span; // How many bytes it was decoded from (both halves if it's fused)
+};
+
+struct machine;
+
+// Something a device wants done at a certain cycle (see events.c)
+struct event {
+	uint64_t cycle;
+	void (*fire)(struct machine *m, void *ctx, uint64_t cycle);
+	void *ctx;
+};
+
+// How long one interrupt source has been kept waiting (see interrupts.c)
+struct irq_stats {
+	uint64_t taken;
+	uint64_t measured; // How many of those it knew when it was raised for
+	uint64_t total_latency; // In cycles, from raised to taken
+	uint64_t worst_latency;
+};
+
+// Something memory mapped, like a screen (see bus.c)
+struct device {
+	uint32_t start, end; // Its registers, end included
+	uint8_t (*read)(struct machine *m, void *ctx, uint32_t address); // NULL to just read what's in memory there
+	void (*write)(struct machine *m, void *ctx, uint32_t address, uint8_t value); // NULL if it doesn't care
+	void *ctx; // Handed back to read() and write()
+	void *state; // What goes in snapshots (see device_state()), NULL if it hasn't got any
+	uint32_t state_size;
+};
+
+struct jit;
+struct jit_block;
+struct aot_program;
+struct keyboard;
+
+void pick_engine(struct machine *m);
+void invalidate_code(struct machine *m, uint32_t address);
+void jit_written(struct machine *m, uint32_t address);
+void free_jit(struct machine *m);
+void aot_written(struct machine *m, uint32_t address);
+void use_aot(struct machine *m, const struct aot_program *program);
+uint8_t device_read(struct machine *m, uint32_t address);
+void device_written(struct machine *m, uint32_t address);
+void free_mem(uint8_t *mem);
+void fork_written(struct machine *m);
+void page_dirtied(struct machine *m, uint32_t address);
+uint8_t start_save(struct machine *m);
+void save_written(struct machine *m, uint32_t address);
+void free_save(struct machine *m);
+
+struct machine {
+	struct data data;
+	uint8_t *mem;
+	uint8_t *keyboard_addr;
+	uint8_t testing_mode;
+	uint8_t engine;
+
+	// The engine built for this testing mode, picked once by init_machine()
+	uint8_t (*run)(struct machine *m, uint32_t count, uint8_t (*condition)(struct machine *m, void *ctx), void *ctx);
+	uint64_t run_end; // The engine stops once cyclenum gets here, the end of the budget or the next event
+
+	// A run stops as soon as this address changes (e.g. the screen's control byte)
+	uint8_t io_watching;
+	uint32_t io_watch;
+	uint8_t io_last;
+
+	uint32_t breakpoints[MAX_BREAKPOINTS];
+	uint8_t breakpoint_count;
+
+	// The copy of the machine ENGINE_CHECKED runs the switch on
+	struct data checked_data;
+	uint8_t *checked_mem;
+	uint32_t checked_since_mem;
+
+	// One byte of PAGE_... flags per page, plus one for writes that run off the end of memory
+	uint8_t page_flags[PAGE_COUNT + 1];
+
+	// One bit per page (same pages as page_flags), set when it gets written to (see memory.c)
+	uint64_t dirty[(PAGE_COUNT + 1 + 63) / 64];
+
+	// The predecode cache, allocated the first time the threaded engine runs
+	struct predecoded *code;
+	struct predecoded uncached; // For running code past the end of memory
+
+	// The JIT's state (see jit.c), the rest is here so the compiled code can get to it
+	struct jit *jit;
+	uint8_t jit_exit; // Tells compiled code (JIT or AOT) to go back to the engine after the instruction it's on
+	uint8_t jit_flush; // Something compiled got written over, so it all has to go
+	uint32_t jit_done; // Instructions run so far
+	uint32_t jit_done_limit; // Compiled code only carries on into the next block under this (and run_end)
+	struct jit_block *jit_last; // The block compiled code left from (NULL if it left in the middle)
+
+	// The last time the threaded engine got to the bottom of a possible idle loop (see idle.c)
+	uint32_t idle_at; // Where the jump is, or IDLE_NONE
+	struct data idle_data;
+	uint32_t idle_done;
+
+	// The program translated ahead of time for ENGINE_AOT, if there is one (see aot.c)
+	const struct aot_program *aot;
+	uint8_t *aot_disabled; // One per block, set if the program wrote over it
+	uint32_t *aot_lookup; // Which block (plus 1) starts at each address, by the bottom 16 bits
+
+	// What's on the bus besides memory (see bus.c)
+	struct device devices[MAX_DEVICES];
+	uint8_t device_count;
+	uint32_t irq; // One bit for every device that wants an interrupt (see interrupts.c)
+	uint32_t irq_mask; // The ones that are allowed to
+	uint32_t irqs_taken;
+	struct keyboard *keyboard; // Where MTA_KYB_IP gets its lines from, NULL for straight from stdin
+
+	// What the devices want done when (see events.c), a heap on cycle
+	struct event events[MAX_EVENTS];
+	uint8_t event_count;
+	uint64_t next_event; // events[0]'s cycle, UINT64_MAX if there aren't any
+
+	// The file memory was last put in to fork it (see fork.c), -1 if it's changed since
+	int fork_fd;
+
+	// What MTA_SAV_IP saves prog.txt from while the program carries on (see save.c)
+	uint8_t *save_copy;
+	pthread_t save_thread;
+	uint8_t save_started; // save_thread needs joining
+	uint8_t save_status; // SAVE_..., only touch it through save_status()
+
+	// How long interrupts have been kept waiting (see interrupts.c)
+	uint64_t irq_raised[IRQ_SOURCES]; // The cycle each one went up on, for the latency
+	struct irq_stats irq_stats[IRQ_SOURCES];
+};
+
+#define IDLE_NONE 0xFFFFFFFF
+
+void init_machine(struct machine *m, uint8_t *mem, uint8_t testing_mode, uint8_t engine, uint8_t *keyboard_addr) {
+	memset(&m -> data, 0, sizeof(m -> data)); // reset() doesn't touch A, X, Y, SP or the flags
+	setPS(&m -> data, 0); // All zeros isn't all flags clear with LAZY_FLAGS
+	m -> mem = mem;
+	m -> keyboard_addr = keyboard_addr;
+	m -> testing_mode = testing_mode;
+	m -> engine = engine;
+	m -> io_watching = 0;
+	m -> io_watch = 0;
+	m -> io_last = 0;
+	m -> breakpoint_count = 0;
+	m -> checked_mem = NULL;
+	m -> checked_since_mem = 0;
+	memset(m -> page_flags, PAGE_CLEAN, sizeof(m -> page_flags));
+	memset(m -> dirty, 0, sizeof(m -> dirty));
+	m -> code = NULL;
+	m -> jit = NULL;
+	m -> jit_exit = 0;
+	m -> jit_flush = 0;
+	m -> jit_last = NULL;
+	m -> idle_at = IDLE_NONE;
+	m -> aot = NULL;
+	m -> aot_disabled = NULL;
+	m -> aot_lookup = NULL;
+	m -> device_count = 0;
+	m -> irq = 0;
+	m -> irq_mask = 0xFFFFFFFF;
+	m -> irqs_taken = 0;
+	memset(m -> irq_raised, 0xFF, sizeof(m -> irq_raised)); // IRQ_NOT_RAISED
+	memset(m -> irq_stats, 0, sizeof(m -> irq_stats));
+	m -> keyboard = NULL;
+	m -> event_count = 0;
+	m -> next_event = UINT64_MAX;
+	m -> run_end = 0;
+	m -> fork_fd = -1;
+	m -> save_copy = NULL;
+	m -> save_started = 0;
+	m -> save_status = 0;
+	pick_engine(m);
+
+	return;
+}
+
+void free_machine(struct machine *m) {
+	free_save(m);
+	free_mem(m -> checked_mem);
+	m -> checked_mem = NULL;
+	free(m -> code);
+	m -> code = NULL;
+	free_jit(m);
+	free(m -> aot_disabled);
+	m -> aot_disabled = NULL;
+	free(m -> aot_lookup);
+	m -> aot_lookup = NULL;
+	if (m -> fork_fd >= 0) {
+		close(m -> fork_fd);
+		m -> fork_fd = -1;
+	}
+
+	return;
+}
+
+// How many clock cycles the machine's run since it was reset (cheap, it's just a read)
+uint64_t cycles_run(struct machine *m) {
+	return m -> data.cyclenum;
+}
+
+// How many instructions the machine's run since it was reset, only up to date between runs
+uint64_t instructions_run(struct machine *m) {
+	return m -> data.instructions;
+}
+
+void watch_io(struct machine *m, uint32_t address) {
+	m -> io_watching = 1;
+	m -> io_watch = address;
+	m -> io_last = m -> mem[address];
+	m -> page_flags[address >> PAGE_SHIFT] |= PAGE_WATCHED;
+
+	return;
+}
+
+// Returns 0 if there's no room for another one
+uint8_t add_breakpoint(struct machine *m, uint32_t address) {
+	if (m -> breakpoint_count >= MAX_BREAKPOINTS) {
+		return 0;
+	}
+	m -> breakpoints[m -> breakpoint_count] = address;
+	m -> breakpoint_count++;
+
+	return 1;
+}
+
+void remove_breakpoint(struct machine *m, uint32_t address) {
+	for (uint8_t i = 0; i < m -> breakpoint_count; i++) {
+		if (m -> breakpoints[i] == address) {
+			m -> breakpoint_count--;
+			m -> breakpoints[i] = m -> breakpoints[m -> breakpoint_count];
+			return;
+		}
+	}
+
+	return;
+}
+
+uint8_t is_breakpoint(struct machine *m, uint32_t address) {
+	for (uint8_t i = 0; i < m -> breakpoint_count; i++) {
+		if (m -> breakpoints[i] == address) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+When the instructions run on a machine (rather than through execute()) all of their
+writes go through these, so anything that depends on what's in memory (like the
+predecode cache) can find out it changed. If the host writes to memory while a
+machine is running, it should call bytes_written() afterwards for the same reason.
+*/
+
+void page_written(struct machine *m, uint32_t address) {
+	uint8_t flags = m -> page_flags[address >> PAGE_SHIFT];
+
+	if (flags & PAGE_CODE) {
+		invalidate_code(m, address);
+	}
+	if (flags & PAGE_JIT) {
+		jit_written(m, address);
+	}
+	if (flags & PAGE_AOT) {
+		aot_written(m, address);
+	}
+	if ((flags & PAGE_WATCHED) && m -> io_watching && address == m -> io_watch) {
+		m -> jit_exit = 1;
+	}
+	if (flags & PAGE_DEVICE) {
+		device_written(m, address);
+	}
+	if (flags & PAGE_FORKED) {
+		fork_written(m);
+	}
+	if (flags & PAGE_CLEAN) {
+		page_dirtied(m, address);
+	}
+	if (flags & PAGE_SAVED) {
+		save_written(m, address);
+	}
+
+	return;
+}
+
+static inline void store_byte(struct machine *m, uint32_t address, uint8_t value) {
+	// Read before writing, otherwise the compiler has to assume the write might have changed it
+	uint8_t flags = m -> page_flags[address >> PAGE_SHIFT];
+
+	m -> mem[address] = value;
+	if (flags) {
+		page_written(m, address);
+	}
+
+	return;
+}
+
+// Reads go through this instead when there might be a device there
+static inline uint8_t load_byte(struct machine *m, uint32_t address) {
+	if (m -> page_flags[address >> PAGE_SHIFT] & PAGE_DEVICE) {
+		return device_read(m, address);
+	}
+
+	return m -> mem[address];
+}
+
+void bytes_written(struct machine *m, uint32_t address, uint32_t length) {
+	for (uint32_t i = address; i < address + length; i++) {
+		if (m -> page_flags[i >> PAGE_SHIFT]) {
+			page_written(m, i);
+		}
+	}
+
+	return;
+}
+
+static inline void push_byte(struct machine *m, uint8_t val, uint8_t testing_mode) {
+	uint32_t address = m -> data.SP + STACK_RANGE[0];
+
+	stackPush(&m -> data, m -> mem, val, testing_mode);
+	if (m -> page_flags[address >> PAGE_SHIFT]) {
+		page_written(m, address);
+	}
+
+	return;
+}
+
+static inline uint8_t pop_byte(struct machine *m, uint8_t testing_mode) {
+	uint8_t val = stackPop(&m -> data, m -> mem, testing_mode);
+	uint32_t address = m -> data.SP + STACK_RANGE[0]; // stackPop() clears what it popped
+
+	if (m -> page_flags[address >> PAGE_SHIFT]) {
+		page_written(m, address);
+	}
+
+	return val;
+}
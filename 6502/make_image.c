@@ -0,0 +1,44 @@
+/*
+
+	Turns a prog.txt into a program image (see image.c), which
+	loads a lot faster.
+
+		./make_image prog.txt prog.img
+
+*/
+
+#include "cpu6502.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		printf("Usage: %s prog.txt prog.img\n", argv[0]);
+		return 1;
+	}
+
+	uint8_t *mem = make_mem();
+	if (mem == NULL) {
+		perror("Failed to allocate memory");
+		return 1;
+	}
+
+	FILE *fptr = fopen(argv[1], "r");
+	if (fptr == NULL) {
+		perror("AHHH ABORT ABORT FAILED TO OPEN FILE!!! AH!!!!");
+		return 1;
+	}
+	struct data data = {0};
+	loadProgFromFile(data, mem, fptr);
+	fclose(fptr);
+
+	if (!write_image(mem, argv[2])) {
+		perror("Failed to write the image");
+		return 1;
+	}
+	printf("Wrote %s\n", argv[2]);
+	free_mem(mem);
+
+	return 0;
+}
@@ -0,0 +1,264 @@
+/*******************************************************
+
+Making the 16MB of memory a machine runs in.
+
+Hosts used to malloc() all 16MB and then zero the RAM
+byte by byte with initialise_mem(), which meant every
+machine touched at least 1MB of it before running a
+single instruction (and a few KB of program doesn't need
+anywhere near that). make_mem() asks the OS for it with
+mmap() instead, which doesn't actually give us any memory
+yet: every 4KB page gets a real page the first time it's
+written to, and until then reads of it all come from one
+page of zeros the kernel shares between everything. So it
+starts out all zeros for free (no initialise_mem()), and a
+machine only ever costs the pages its program has
+actually written to.
+
+It's still one flat block as far as everything else is
+concerned, so mem[address] works the same as always and
+none of the engines had to change.
+
+Anything that reads every byte (save(), the checked
+engine's copy) is fine, reading doesn't use up any pages.
+Writing zeros over something that's already zero does
+though, so don't zero it by hand.
+
+ROM images: every machine started from the same OS has
+the same ROM, so rather than every one of them parsing
+prog.txt into its own copy, write_rom() saves it once as
+raw bytes (a ROM image) and map_rom() maps that file
+straight into memory. The pages come from the OS's file
+cache, so every machine (in every process) using the
+image shares the one copy, and nothing gets read off the
+disk until the program actually uses it. The mapping is
+private, so if the program writes to its ROM it just gets
+its own copy of that page and the file never changes.
+
+Dirty pages: every machine keeps a bit per page that gets
+set the first time the program writes to it (or the host,
+through bytes_written()), so anything that wants to know
+what changed (saving, snapshots) can go straight to those
+pages instead of looking through all 16MB. Clean pages are
+PAGE_CLEAN, so the first write to each one goes the slow
+way round through page_written() and gets marked, and
+after that it's back to just the flags check like any
+other page. clear_dirty() starts it all again. A new
+machine (or a forked one, see fork.c) starts out with
+nothing dirty. The plain execute() doesn't have a machine
+to mark, so it doesn't count, and neither does anything
+the host puts straight into memory.
+
+*******************************************************/
+
+#include <sys/mman.h>
+
+// Indexed writes near the top can run a bit off the end (see page_flags), so there's a spare page after it
+#define MEM_SIZE (MAX_MEM + 1 + PAGE_SIZE)
+
+// All zeros, returns NULL if there's no memory for it
+uint8_t *make_mem(void) {
+#ifdef MAP_ANONYMOUS
+	// MAP_NORESERVE so having lots of machines doesn't count as using 16MB each either
+	void *mem = mmap(NULL, MEM_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+	if (mem == MAP_FAILED) {
+		return NULL;
+	}
+
+	return (uint8_t*) mem;
+#else
+	// Without mmap() calloc() is the next best thing, most of them get big blocks straight from the OS anyway
+	return (uint8_t*) calloc(MEM_SIZE, 1);
+#endif
+}
+
+/*
+Makes length bytes from start on (both on pages) all zeros again. If it can, it maps new
+pages over the top rather than writing to them, so they go back to not costing anything
+(and anything map_rom() put there goes too).
+*/
+void zero_mem(uint8_t *mem, uint32_t start, uint32_t length) {
+#ifdef MAP_ANONYMOUS
+	long os_page = sysconf(_SC_PAGESIZE);
+	if ((uintptr_t) &mem[start] % os_page == 0 && length % os_page == 0 &&
+		mmap(&mem[start], length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0) != MAP_FAILED) {
+		return;
+	}
+#endif
+	memset(&mem[start], 0, length);
+
+	return;
+}
+
+// Returns 1 if all PAGE_SIZE bytes from page on are 0
+uint8_t page_is_zero(const uint8_t *page) {
+	// If the first one is 0 and every byte is the same as the one after it, they're all 0
+	return page[0] == 0 && memcmp(page, page + 1, PAGE_SIZE - 1) == 0;
+}
+
+/*
+Saves start to end (included) as a ROM image for map_rom(). All zero pages are skipped
+over rather than written, so on most file systems they don't take up any disk. It's
+written to a temporary file and renamed over path at the end, because anything that has
+the old one mapped would see it change otherwise. Returns 0 if it couldn't write it.
+*/
+uint8_t write_rom(uint8_t *mem, const char *path, uint32_t start, uint32_t end) {
+	char temp_path[300];
+	uint32_t size = end - start + 1;
+	uint8_t skipped = 0;
+
+	FILE *fptr = open_temp(path, temp_path, sizeof(temp_path));
+	if (fptr == NULL) {
+		return 0;
+	}
+
+	for (uint32_t i = 0; i < size; i += PAGE_SIZE) {
+		uint32_t length = (size - i < PAGE_SIZE) ? size - i : PAGE_SIZE;
+		skipped = (length == PAGE_SIZE && page_is_zero(&mem[start + i]));
+		if (skipped) {
+			fseek(fptr, i + PAGE_SIZE, SEEK_SET);
+		} else {
+			fseek(fptr, i, SEEK_SET);
+			fwrite(&mem[start + i], 1, length, fptr);
+		}
+	}
+	// Seeking past the end doesn't make the file any longer by itself
+	if (skipped) {
+		fseek(fptr, size - 1, SEEK_SET);
+		fputc(0, fptr);
+	}
+
+	// It has to be on the disk before the rename, the host trusts it from its key alone (like save_prog())
+	uint8_t failed = ferror(fptr);
+	failed |= (fflush(fptr) != 0 || fsync(fileno(fptr)) != 0);
+	failed |= (fclose(fptr) != 0);
+	if (failed || rename(temp_path, path) != 0) {
+		remove(temp_path);
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+Puts the ROM image at path into memory from start on (memory has to come from
+make_mem()). If start isn't on a page it gets read in the normal way instead. Returns 0
+if it couldn't, memory's left as it was then unless the mapping went wrong halfway.
+*/
+uint8_t map_rom(uint8_t *mem, const char *path, uint32_t start) {
+	FILE *fptr = fopen(path, "rb");
+	if (fptr == NULL) {
+		return 0;
+	}
+	fseek(fptr, 0, SEEK_END);
+	long size = ftell(fptr);
+
+	if (size <= 0 || (uint32_t) size > MAX_MEM + 1 - start) {
+		fclose(fptr);
+		return 0;
+	}
+
+#ifdef MAP_ANONYMOUS
+	// It goes over the top of make_mem()'s mapping, which just drops the pages that were there
+	if ((uintptr_t) &mem[start] % sysconf(_SC_PAGESIZE) == 0) {
+		void *rom = mmap(&mem[start], size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fileno(fptr), 0);
+		fclose(fptr); // The mapping doesn't need it open
+		return rom != MAP_FAILED;
+	}
+#endif
+
+	rewind(fptr);
+	size_t got = fread(&mem[start], 1, size, fptr);
+	fclose(fptr);
+
+	return got == (size_t) size;
+}
+
+// Called from page_written() the first time a clean page gets written to
+void page_dirtied(struct machine *m, uint32_t address) {
+	uint32_t page = address >> PAGE_SHIFT;
+
+	m -> page_flags[page] &= ~PAGE_CLEAN;
+	m -> dirty[page / 64] |= (uint64_t) 1 << (page % 64);
+
+	return;
+}
+
+// Returns 1 if the page address is in has been written to since clear_dirty()
+uint8_t is_dirty(struct machine *m, uint32_t address) {
+	uint32_t page = address >> PAGE_SHIFT;
+
+	return (m -> dirty[page / 64] >> (page % 64)) & 1;
+}
+
+/*
+Returns where the first dirty page is, starting from the page address is in, or
+MAX_MEM + 1 if there aren't any more. To go through all of them:
+	for (uint32_t i = next_dirty(m, 0); i <= MAX_MEM; i = next_dirty(m, i + PAGE_SIZE))
+*/
+uint32_t next_dirty(struct machine *m, uint32_t address) {
+	for (uint32_t page = address >> PAGE_SHIFT; page < PAGE_COUNT; page++) {
+		uint64_t word = m -> dirty[page / 64] >> (page % 64);
+		if (word == 0) {
+			page |= 63; // Nothing else in this word, skip to the next one
+			continue;
+		}
+		if (word & 1) {
+			return page << PAGE_SHIFT;
+		}
+	}
+
+	return MAX_MEM + 1;
+}
+
+// Makes every page clean again
+void clear_dirty(struct machine *m) {
+	memset(m -> dirty, 0, sizeof(m -> dirty));
+	for (uint32_t i = 0; i <= PAGE_COUNT; i++) {
+		m -> page_flags[i] |= PAGE_CLEAN;
+	}
+
+	return;
+}
+
+/*
+Like save(), but only the pages that have been written to since clear_dirty(), and all of
+each one (zeros as well), so loading it on top of whatever was last saved gives what's in
+memory now. Leaves out range like save() does. It doesn't clear them itself.
+*/
+void save_dirty(struct machine *m, FILE *fptr, uint32_t *range) {
+	struct save_buffer buffer;
+	uint32_t next = MAX_MEM + 1; // Straight after the last byte saved, so it knows when it needs an "m" line
+
+	buffer.fptr = fptr;
+	buffer.used = 0;
+	for (uint32_t page = next_dirty(m, 0); page <= MAX_MEM; page = next_dirty(m, page + PAGE_SIZE)) {
+		for (uint32_t address = page; address < page + PAGE_SIZE; address++) {
+			if (address >= range[0] && address <= range[1]) {
+				continue;
+			}
+			if (address != next) {
+				save_address(&buffer, address);
+			}
+			save_value(&buffer, m -> mem[address]);
+			next = address + 1;
+		}
+	}
+	flush_save(&buffer);
+
+	return;
+}
+
+void free_mem(uint8_t *mem) {
+	if (mem == NULL) {
+		return;
+	}
+#ifdef MAP_ANONYMOUS
+	munmap(mem, MEM_SIZE);
+#else
+	free(mem);
+#endif
+
+	return;
+}
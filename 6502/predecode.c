@@ -0,0 +1,232 @@
+/*******************************************************
+
+The predecode cache, used by the threaded engine.
+
+Running an instruction normally means reading the opcode,
+looking up where its body is, and then reading the
+operand back out of memory a byte at a time (3 reads and
+2 increments for every absolute address). The long loops
+in the OS images do that for the same few instructions
+over and over again, so the first time an address gets
+run its handler, operand and length are saved, and after
+that the engine just uses those. It's a fixed size table
+with a slot for every address that ends in the same 16
+bits, so a slot only ever holds one of them at a time.
+
+Some pairs of instructions come one after the other
+nearly every time (like "LDA #imm; STA abs" in the print
+routines, or "INY; BNE" at the bottom of loops). Those
+get decoded together as a superinstruction: the first
+one's entry goes to a copy of its body that goes
+straight on to the second one's body afterwards, without
+looking it up in the cache. Both bodies still run as
+normal, so the flags and cycles come out the same, and
+the engine still does all of its checks in between.
+
+Programs can write over their own code (prog.txt is
+loaded into the same memory the program writes to), so
+every page with something cached in it is marked
+PAGE_CODE, and a write to one of those pages throws away
+any cached instruction with the written byte in it
+(which for a superinstruction includes its second half).
+
+*******************************************************/
+
+#define CODE_CACHE_SIZE 65536
+#define CODE_CACHE_MASK (CODE_CACHE_SIZE - 1)
+
+// How many bytes each instruction's body actually reads, anything not here is 1
+const uint8_t instruction_length[256] = {
+	[INS_STA_ZP] = 2, [INS_STA_ZX] = 2, [INS_STA_IX] = 2, [INS_STA_IY] = 2, [INS_STX_ZP] = 2, [INS_STX_ZY] = 2,
+	[INS_STY_ZP] = 2, [INS_STY_ZX] = 2, [INS_DEC_ZP] = 2, [INS_DEC_ZX] = 2, [INS_INC_ZP] = 2, [INS_INC_ZX] = 2,
+	[INS_ROL_ZP] = 2, [INS_ROL_ZX] = 2, [INS_ROR_ZP] = 2, [INS_ROR_ZX] = 2, [INS_ASL_ZP] = 2, [INS_ASL_ZX] = 2,
+	[INS_LSR_ZP] = 2, [INS_LSR_ZX] = 2, [INS_CMP_IM] = 2, [INS_CMP_ZP] = 2, [INS_CMP_ZX] = 2, [INS_CMP_IX] = 2,
+	[INS_CMP_IY] = 2, [INS_CPX_IM] = 2, [INS_CPX_ZP] = 2, [INS_CPX_AB] = 2, [INS_CPY_IM] = 2, [INS_CPY_ZP] = 2,
+	[INS_CPY_AB] = 2, [INS_AND_IM] = 2, [INS_AND_ZP] = 2, [INS_AND_ZX] = 2, [INS_AND_IX] = 2, [INS_AND_IY] = 2,
+	[INS_EOR_IM] = 2, [INS_EOR_ZP] = 2, [INS_EOR_ZX] = 2, [INS_EOR_IX] = 2, [INS_EOR_IY] = 2, [INS_ORA_IM] = 2,
+	[INS_ORA_ZP] = 2, [INS_ORA_ZX] = 2, [INS_ORA_IX] = 2, [INS_ORA_IY] = 2, [INS_BVS_RL] = 2, [INS_BVC_RL] = 2,
+	[INS_BCS_RL] = 2, [INS_BCC_RL] = 2, [INS_BEQ_RL] = 2, [INS_BMI_RL] = 2, [INS_BNE_RL] = 2, [INS_BPL_RL] = 2,
+	[INS_BIT_ZP] = 2, [INS_ADC_IM] = 2, [INS_ADC_ZP] = 2, [INS_ADC_ZX] = 2, [INS_ADC_IX] = 2, [INS_ADC_IY] = 2,
+	[INS_SBC_IM] = 2, [INS_SBC_ZP] = 2, [INS_SBC_ZX] = 2, [INS_SBC_IX] = 2, [INS_SBC_IY] = 2, [INS_LDX_IM] = 2,
+	[INS_LDX_ZP] = 2, [INS_LDX_ZY] = 2, [INS_LDY_IM] = 2, [INS_LDY_ZP] = 2, [INS_LDY_ZX] = 2, [INS_LDA_IM] = 2,
+	[INS_LDA_ZP] = 2, [INS_LDA_ZX] = 2, [INS_LDA_IX] = 2, [INS_LDA_IY] = 2,
+
+	[INS_STA_AB] = 4, [INS_STA_AX] = 4, [INS_STA_AY] = 4, [INS_STX_AB] = 4, [INS_STY_AB] = 4, [INS_DEC_AB] = 4,
+	[INS_DEC_AX] = 4, [INS_INC_AB] = 4, [INS_INC_AX] = 4, [INS_ROL_AB] = 4, [INS_ROL_AX] = 4, [INS_ROR_AB] = 4,
+	[INS_ROR_AX] = 4, [INS_ASL_AB] = 4, [INS_ASL_AX] = 4, [INS_LSR_AB] = 4, [INS_LSR_AX] = 4, [INS_CMP_AB] = 4,
+	[INS_CMP_AX] = 4, [INS_CMP_AY] = 4, [INS_AND_AB] = 4, [INS_AND_AX] = 4, [INS_AND_AY] = 4, [INS_EOR_AB] = 4,
+	[INS_EOR_AX] = 4, [INS_EOR_AY] = 4, [INS_ORA_AB] = 4, [INS_ORA_AX] = 4, [INS_ORA_AY] = 4, [INS_BIT_AB] = 4,
+	[INS_ADC_AB] = 4, [INS_ADC_AX] = 4, [INS_ADC_AY] = 4, [INS_SBC_AB] = 4, [INS_SBC_AX] = 4, [INS_SBC_AY] = 4,
+	[INS_JMP_AB] = 4, [INS_JMP_ID] = 4, [INS_JSR_AB] = 4, [INS_LDX_AB] = 4, [INS_LDX_AY] = 4, [INS_LDY_AB] = 4,
+	[INS_LDY_AX] = 4, [INS_LDA_AB] = 4, [INS_LDA_AX] = 4, [INS_LDA_AY] = 4,
+};
+
+/*
+The pairs that get fused, found by counting which opcode comes after which while
+the OS boots and runs. The first one mustn't be anything that jumps (or talks to
+the host), because the second one is assumed to be right after it.
+*/
+const uint8_t fused_pairs[][2] = {
+	{INS_LDA_IM, INS_STA_AB}, {INS_LDA_IM, INS_STA_ZP}, {INS_LDA_IM, INS_PHA_IP}, {INS_LDA_IM, INS_CMP_ZP},
+	{INS_CMP_IM, INS_BEQ_RL}, {INS_CMP_IM, INS_BNE_RL}, {INS_CMP_IM, INS_BCC_RL}, {INS_CMP_IM, INS_BCS_RL},
+	{INS_CMP_ZP, INS_BEQ_RL}, {INS_CMP_ZP, INS_BNE_RL}, {INS_CMP_ZP, INS_BCC_RL}, {INS_CMP_ZP, INS_BCS_RL},
+	{INS_CMP_AY, INS_BEQ_RL}, {INS_CMP_AY, INS_BNE_RL}, {INS_CMP_AY, INS_PHP_IP},
+	{INS_CPX_IM, INS_BEQ_RL}, {INS_CPX_IM, INS_BNE_RL}, {INS_CPY_IM, INS_BEQ_RL}, {INS_CPY_IM, INS_BNE_RL},
+	{INS_INY_IP, INS_BNE_RL}, {INS_INX_IP, INS_BNE_RL}, {INS_DEY_IP, INS_BNE_RL}, {INS_DEX_IP, INS_BNE_RL},
+	{INS_INC_ZP, INS_BNE_RL}, {INS_DEC_ZP, INS_BNE_RL},
+	{INS_INY_IP, INS_CMP_IM}, {INS_INY_IP, INS_LDA_IY}, {INS_INX_IP, INS_LDA_AX},
+	{INS_LDA_IY, INS_CMP_AY}, {INS_LDA_AX, INS_CMP_IM}, {INS_LDA_AB, INS_ADC_IM}, {INS_ADC_IM, INS_STA_AB},
+};
+
+uint8_t can_fuse(uint8_t first, uint8_t second) {
+	for (uint32_t i = 0; i < sizeof(fused_pairs) / sizeof(fused_pairs[0]); i++) {
+		if (fused_pairs[i][0] == first && fused_pairs[i][1] == second) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+uint8_t length_of(uint8_t opcode) {
+	return (instruction_length[opcode] == 0) ? 1 : instruction_length[opcode];
+}
+
+uint32_t operand_at(uint8_t *mem, uint32_t address, uint8_t length) {
+	uint32_t operand = 0;
+
+	if (length >= 2) {
+		operand = mem[address + 1];
+	}
+	if (length == 4) {
+		operand |= (mem[address + 2] << 8) | (mem[address + 3] << 16);
+	}
+
+	return operand;
+}
+
+// Instructions that can write to memory, so compiled code has to check if it should stop after them
+const uint8_t writes_memory[256] = {
+	[INS_STA_ZP] = 1, [INS_STA_ZX] = 1, [INS_STA_AB] = 1, [INS_STA_AX] = 1, [INS_STA_AY] = 1, [INS_STA_IX] = 1,
+	[INS_STA_IY] = 1, [INS_STX_ZP] = 1, [INS_STX_ZY] = 1, [INS_STX_AB] = 1, [INS_STY_AB] = 1, [INS_STY_ZP] = 1,
+	[INS_STY_ZX] = 1, [INS_DEC_ZP] = 1, [INS_DEC_ZX] = 1, [INS_DEC_AB] = 1, [INS_DEC_AX] = 1, [INS_INC_ZP] = 1,
+	[INS_INC_ZX] = 1, [INS_INC_AB] = 1, [INS_INC_AX] = 1, [INS_ROL_ZP] = 1, [INS_ROL_ZX] = 1, [INS_ROL_AB] = 1,
+	[INS_ROL_AX] = 1, [INS_ROR_ZP] = 1, [INS_ROR_ZX] = 1, [INS_ROR_AB] = 1, [INS_ROR_AX] = 1, [INS_ASL_ZP] = 1,
+	[INS_ASL_ZX] = 1, [INS_ASL_AB] = 1, [INS_ASL_AX] = 1, [INS_PHA_IP] = 1, [INS_PLA_IP] = 1, [INS_PHP_IP] = 1,
+	[INS_PLP_IP] = 1,
+};
+
+// Instructions that end a block of compiled code (they change where the program goes)
+const uint8_t ends_block[256] = {
+	[INS_BRK_IP] = 1, [INS_RTI_IP] = 1, [INS_BVS_RL] = 1, [INS_BVC_RL] = 1, [INS_BCS_RL] = 1, [INS_BCC_RL] = 1,
+	[INS_BEQ_RL] = 1, [INS_BMI_RL] = 1, [INS_BNE_RL] = 1, [INS_BPL_RL] = 1, [INS_JMP_AB] = 1, [INS_JMP_ID] = 1,
+	[INS_JSR_AB] = 1, [INS_RTS_IP] = 1,
+};
+
+// Branches and JMP_AB, which always go to the same place if they're taken
+uint8_t is_jump(uint8_t opcode) {
+	switch (opcode) {
+		case INS_BVS_RL: case INS_BVC_RL: case INS_BCS_RL: case INS_BCC_RL:
+		case INS_BEQ_RL: case INS_BMI_RL: case INS_BNE_RL: case INS_BPL_RL:
+		case INS_JMP_AB:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+// Where a jump at address goes if it's taken, worked out the same way its body does it
+uint32_t branch_target(uint8_t opcode, uint32_t address, uint32_t operand) {
+	uint32_t target = address + 1; // Where the body has *address when it works out the branch
+	uint32_t quirk = (opcode == INS_BNE_RL); // BNE's body is out by one both ways
+
+	if (opcode == INS_JMP_AB) {
+		return operand;
+	}
+	if (operand & 0b10000000) {
+		target -= (operand & 0b01111111) + quirk;
+	} else {
+		target += (operand & 0b01111111) - quirk;
+	}
+
+	return target + 1;
+}
+
+uint8_t is_idle_loop(uint8_t *mem, uint32_t address);
+
+// Something that can never be the address of an instruction that goes in this slot
+#define EMPTY_SLOT(slot) (0xFF000000 | ((slot) ^ 1))
+
+// Sets up the cache with nothing in it, returns 0 if there wasn't enough memory
+uint8_t start_predecode(struct machine *m) {
+	if (m -> code != NULL) {
+		return 1;
+	}
+	m -> code = (struct predecoded*) malloc(CODE_CACHE_SIZE * sizeof(struct predecoded));
+	if (m -> code == NULL) {
+		perror("Failed to allocate memory for the predecode cache");
+		return 0;
+	}
+	for (uint32_t i = 0; i < CODE_CACHE_SIZE; i++) {
+		m -> code[i].address = EMPTY_SLOT(i);
+	}
+
+	return 1;
+}
+
+/*
+Decodes the instruction at address into the cache. table is the engine's labels,
+fused is its labels for the first halves of superinstructions, and idle is where it
+goes before a jump at the bottom of an idle loop (see idle.c).
+*/
+struct predecoded *decode(struct machine *m, uint32_t address, void **table, void **fused, void *idle) {
+	struct predecoded *entry = &m -> uncached;
+	uint8_t *mem = m -> mem;
+	uint8_t opcode = mem[address];
+
+	if (address <= MAX_MEM) {
+		entry = &m -> code[address & CODE_CACHE_MASK];
+	}
+	entry -> handler = table[opcode];
+	entry -> address = address;
+	entry -> length = length_of(opcode);
+	entry -> span = entry -> length;
+	entry -> operand = operand_at(mem, address, entry -> length);
+	if (entry == &m -> uncached) {
+		return entry;
+	}
+
+	uint32_t second = address + entry -> length;
+	if (is_jump(opcode) && is_idle_loop(mem, address)) {
+		entry -> next = entry -> handler;
+		entry -> handler = idle;
+	} else if (second + 3 <= MAX_MEM && fused[opcode] != NULL && can_fuse(opcode, mem[second]) &&
+		!(is_jump(mem[second]) && is_idle_loop(mem, second))) {
+		entry -> handler = fused[opcode];
+		entry -> next = table[mem[second]];
+		entry -> next_operand = operand_at(mem, second, length_of(mem[second]));
+		entry -> span += length_of(mem[second]);
+	}
+
+	// The end of it might be on the next page, which needs to know about it too
+	m -> page_flags[address >> PAGE_SHIFT] |= PAGE_CODE;
+	m -> page_flags[(address + entry -> span - 1) >> PAGE_SHIFT] |= PAGE_CODE;
+
+	return entry;
+}
+
+// Called when a PAGE_CODE page gets written to, throws away anything cached with that byte in it
+void invalidate_code(struct machine *m, uint32_t address) {
+	if (m -> code == NULL) {
+		return;
+	}
+	for (uint32_t i = 0; i < 8; i++) {
+		uint32_t start = address - i;
+		struct predecoded *entry = &m -> code[start & CODE_CACHE_MASK];
+		if (entry -> address == start && entry -> span > i) {
+			entry -> address = EMPTY_SLOT(start & CODE_CACHE_MASK);
+		}
+	}
+
+	return;
+}
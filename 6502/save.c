@@ -0,0 +1,138 @@
+/*******************************************************
+
+Saving prog.txt in the background.
+
+MTA_SAV_IP used to stop everything until all of memory
+had been written out to prog.txt, which is a few ms for
+Sigma OS and a lot longer for anything bigger. Machines
+(not execute(), that's still the old way) do it with
+start_save() instead: it copies memory into a second
+block (the save copy) and then a thread writes prog.txt
+from that while the program carries on, so it doesn't
+matter what the program does to memory in the meantime,
+prog.txt is what was there at the MTA_SAV_IP.
+
+Copying 16MB every time would be as slow as saving it,
+so the copy only gets the pages that have changed: every
+page that's the same in the copy is PAGE_SAVED, and the
+first write to one clears that (the same way PAGE_CLEAN
+works, see memory.c). The first save copies every page
+that isn't all zeros (the copy starts out all zeros), and
+after that it's just the pages the program wrote to. The
+host has to call bytes_written() after writing to memory
+itself, or the next save won't see it.
+
+Only one save goes at a time, another MTA_SAV_IP waits
+for the last one to finish first. When a machine turns
+itself off (MTA_OFF_IP/MTA_OFS_IP) run_for() and friends
+wait for it as well, so the final save is always on the
+disk by the time the host hears about it. save_status()
+says how the last one went, wait_save() waits for it.
+
+If there's no memory for the copy or the thread can't
+start, it just saves the old way.
+
+*******************************************************/
+
+#include <pthread.h>
+
+// What save_status() can say about the last save
+#define SAVE_NONE 0 // There hasn't been one
+#define SAVE_RUNNING 1 // It's still being written
+#define SAVE_DONE 2 // prog.txt has it
+#define SAVE_FAILED 3 // It couldn't be written, prog.txt is still the one before
+
+void *save_thread(void *arg) {
+	struct machine *m = (struct machine*) arg;
+	uint8_t status = SAVE_DONE;
+
+	if (!save_prog(m -> save_copy)) {
+		perror("AHHH ABORT ABORT FAILED TO OPEN FILE!!! AH!!!!");
+		status = SAVE_FAILED;
+	}
+	__atomic_store_n(&m -> save_status, status, __ATOMIC_RELEASE);
+
+	return NULL;
+}
+
+// Returns how the last save went (SAVE_...) without waiting for it
+uint8_t save_status(struct machine *m) {
+	return __atomic_load_n(&m -> save_status, __ATOMIC_ACQUIRE);
+}
+
+// Waits for the save that's going (if there is one) to finish, and returns how it went
+uint8_t wait_save(struct machine *m) {
+	if (m -> save_started) {
+		pthread_join(m -> save_thread, NULL);
+		m -> save_started = 0;
+	}
+
+	return save_status(m);
+}
+
+/*
+Brings the save copy up to date with memory. Pages that are all inside SAVE_SKIP don't
+get saved, so they don't get copied either. Returns 0 if there's no memory for it.
+*/
+uint8_t update_save_copy(struct machine *m) {
+	uint8_t first = (m -> save_copy == NULL);
+
+	if (first) {
+		m -> save_copy = make_mem();
+		if (m -> save_copy == NULL) {
+			return 0;
+		}
+	}
+
+	for (uint32_t page = 0; page < PAGE_COUNT; page++) {
+		uint32_t address = page << PAGE_SHIFT;
+		if (m -> page_flags[page] & PAGE_SAVED) {
+			continue;
+		}
+		if (address >= SAVE_SKIP[0] && address + PAGE_MASK <= SAVE_SKIP[1]) {
+			continue;
+		}
+		// The copy's already all zeros the first time, no need to touch those pages
+		if (!first || !page_is_zero(&m -> mem[address])) {
+			memcpy(&m -> save_copy[address], &m -> mem[address], PAGE_SIZE);
+		}
+		m -> page_flags[page] |= PAGE_SAVED;
+	}
+
+	return 1;
+}
+
+// Starts saving prog.txt like save_prog() does, returns 0 if it couldn't even do that
+uint8_t start_save(struct machine *m) {
+	wait_save(m);
+
+	if (update_save_copy(m)) {
+		__atomic_store_n(&m -> save_status, SAVE_RUNNING, __ATOMIC_RELEASE);
+		if (pthread_create(&m -> save_thread, NULL, save_thread, m) == 0) {
+			m -> save_started = 1;
+			return 1;
+		}
+	}
+
+	// Just do it here then
+	uint8_t saved = save_prog(m -> mem);
+	__atomic_store_n(&m -> save_status, saved ? SAVE_DONE : SAVE_FAILED, __ATOMIC_RELEASE);
+
+	return saved;
+}
+
+// Called from page_written() the first time a page gets written to after the save copy got it
+void save_written(struct machine *m, uint32_t address) {
+	m -> page_flags[address >> PAGE_SHIFT] &= ~PAGE_SAVED;
+
+	return;
+}
+
+// Called by free_machine()
+void free_save(struct machine *m) {
+	wait_save(m);
+	free_mem(m -> save_copy);
+	m -> save_copy = NULL;
+
+	return;
+}
@@ -0,0 +1,273 @@
+/*******************************************************
+
+The screen: Sigma OS's output, as a device.
+
+The program talks to it through two bytes, the control
+byte (start) and the character before it (start - 1):
+	bit 0 (write): adds the character to the line
+	bit 1 (print): prints the line
+	bit 2 (clear): empties the line after printing it
+Each one only counts when it goes from off to on, so the
+program sets it and then clears it again.
+
+Sigma OS used to printf() every line as it got printed,
+which for a chatty program is a lot of little writes and
+a good part of the time it takes. Now a print just copies
+the line into a buffer, and the buffer goes out to the
+host's file descriptor in one big write() when it fills
+up, or when there's been something in it for
+SCREEN_FLUSH_CYCLES cycles (or SCREEN_FLUSH_MS of real
+time, for when the program's waiting around), so nothing
+sits there forever. The host gets a chance to do that
+with tick_screen() after each run, and flush_screen()
+sends it all out whenever (before the host prints
+anything itself with write(), printf() is fine as long as
+it's stdout, that gets flushed first).
+
+Headless (fd -1) it doesn't write anywhere, and with
+screen_capture() turned on everything printed gets kept
+in memory as well (for batch runs, or anything that wants
+to look at the output afterwards), where
+screen_captured() gets it.
+
+Only the line being built up (struct screen_state) goes
+in snapshots, anything already printed has been printed.
+
+*******************************************************/
+
+#include <time.h>
+
+#define SCREEN_LINE 253 // How long a line can get, like Sigma OS always had it
+#define SCREEN_BUFFER 65536
+#define SCREEN_FLUSH_CYCLES 20000000
+#define SCREEN_FLUSH_MS 20
+
+// What the control byte's bits do
+#define SCREEN_WRITE 0b00000001
+#define SCREEN_PRINT 0b00000010
+#define SCREEN_CLEAR 0b00000100
+
+// The line it's in the middle of, which is all that goes in snapshots
+struct screen_state {
+	uint8_t written; // Bit 0 was on last time, so it's already been added
+	uint8_t printed; // Same for bit 1
+	uint16_t length;
+	char line[SCREEN_LINE];
+};
+
+struct screen {
+	struct screen_state state;
+
+	struct machine *m;
+	uint32_t start;
+	int fd; // -1 for headless
+	uint64_t flush_cycles; // Goes out after this many cycles, 0 for after every print
+
+	char buffer[SCREEN_BUFFER];
+	uint32_t used;
+	uint64_t waiting_since; // The cycle the first thing still in the buffer went in
+	struct timespec waiting_time; // And when that was
+
+	uint8_t capturing;
+	char *captured;
+	size_t captured_length;
+	size_t captured_size;
+};
+
+// Writes all of it to fd, or as much as it can
+void write_all(int fd, const char *text, uint32_t length) {
+	while (length > 0) {
+		ssize_t wrote = write(fd, text, length);
+		if (wrote < 0 && errno == EINTR) {
+			continue;
+		}
+		if (wrote <= 0) {
+			return; // Nowhere to put it, so it's gone (the same as printf() would have done)
+		}
+		text += wrote;
+		length -= wrote;
+	}
+
+	return;
+}
+
+// Sends everything in the buffer out to the host
+void flush_screen(struct screen *screen) {
+	if (screen -> fd < 0 || screen -> used == 0) {
+		return;
+	}
+	// Anything the host printf()'d before this has to go first
+	if (screen -> fd == STDOUT_FILENO) {
+		fflush(stdout);
+	}
+	write_all(screen -> fd, screen -> buffer, screen -> used);
+	screen -> used = 0;
+
+	return;
+}
+
+void capture_text(struct screen *screen, const char *text, uint32_t length) {
+	if (screen -> captured_length + length > screen -> captured_size) {
+		size_t size = (screen -> captured_size == 0) ? SCREEN_BUFFER : screen -> captured_size * 2;
+		while (size < screen -> captured_length + length) {
+			size *= 2;
+		}
+		char *captured = (char*) realloc(screen -> captured, size);
+		if (captured == NULL) {
+			return; // It just doesn't get kept
+		}
+		screen -> captured = captured;
+		screen -> captured_size = size;
+	}
+	memcpy(&screen -> captured[screen -> captured_length], text, length);
+	screen -> captured_length += length;
+
+	return;
+}
+
+/*
+Puts length bytes of text out on the screen (after anything the program's printed), for
+when the host has something to print that should go with the program's output.
+*/
+void screen_output(struct screen *screen, const char *text, uint32_t length) {
+	if (screen -> capturing) {
+		capture_text(screen, text, length);
+	}
+	if (screen -> fd < 0) {
+		return;
+	}
+
+	if (screen -> used + length > SCREEN_BUFFER) {
+		flush_screen(screen);
+	}
+	if (length > SCREEN_BUFFER) {
+		// Too big for the buffer, so it goes straight out
+		if (screen -> fd == STDOUT_FILENO) {
+			fflush(stdout);
+		}
+		write_all(screen -> fd, text, length);
+		return;
+	}
+	if (screen -> used == 0) {
+		screen -> waiting_since = screen -> m -> data.cyclenum;
+		clock_gettime(CLOCK_MONOTONIC, &screen -> waiting_time);
+	}
+	memcpy(&screen -> buffer[screen -> used], text, length);
+	screen -> used += length;
+
+	if (screen -> m -> data.cyclenum - screen -> waiting_since >= screen -> flush_cycles) {
+		flush_screen(screen);
+	}
+
+	return;
+}
+
+/*
+Flushes the buffer if anything in it has been waiting long enough (SCREEN_FLUSH_CYCLES
+or SCREEN_FLUSH_MS). Hosts call this between runs.
+*/
+void tick_screen(struct screen *screen) {
+	struct timespec now;
+
+	if (screen -> used == 0) {
+		return;
+	}
+	if (screen -> m -> data.cyclenum - screen -> waiting_since >= screen -> flush_cycles) {
+		flush_screen(screen);
+		return;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	int64_t waited = (int64_t) (now.tv_sec - screen -> waiting_time.tv_sec) * 1000 +
+		(now.tv_nsec - screen -> waiting_time.tv_nsec) / 1000000;
+	if (waited >= SCREEN_FLUSH_MS) {
+		flush_screen(screen);
+	}
+
+	return;
+}
+
+void screen_write(struct machine *m, void *ctx, uint32_t address, uint8_t value) {
+	struct screen *screen = (struct screen*) ctx;
+	struct screen_state *state = &screen -> state;
+
+	if (value & SCREEN_WRITE) {
+		// The last byte's kept for the 0 on the end
+		if (!state -> written && state -> length < SCREEN_LINE - 1) {
+			state -> line[state -> length] = m -> mem[screen -> start - 1];
+			state -> length++;
+			if (m -> testing_mode > 1) {
+				printf("char set: %02x\n", state -> line[state -> length - 1]);
+			}
+		}
+		state -> written = 1;
+	} else {
+		state -> written = 0;
+		if (m -> testing_mode > 2) {
+			printf("Addr cleared: %06x\n", m -> data.PC);
+		}
+	}
+	if (value & SCREEN_PRINT) {
+		if (!state -> printed) {
+			// Like printf("%s") did, it stops at a 0
+			screen_output(screen, state -> line, strnlen(state -> line, state -> length));
+			if (value & SCREEN_CLEAR) {
+				memset(state -> line, 0, sizeof(state -> line));
+				state -> length = 0;
+			}
+		}
+		state -> printed = 1;
+	} else {
+		state -> printed = 0;
+	}
+
+	return;
+}
+
+/*
+Puts a screen on the bus with its control byte at start and the character at start - 1,
+writing to fd (-1 for headless). Returns 0 if it couldn't.
+*/
+uint8_t add_screen(struct machine *m, struct screen *screen, uint32_t start, int fd) {
+	memset(&screen -> state, 0, sizeof(screen -> state));
+	screen -> m = m;
+	screen -> start = start;
+	screen -> fd = fd;
+	screen -> flush_cycles = SCREEN_FLUSH_CYCLES;
+	screen -> used = 0;
+	screen -> capturing = 0;
+	screen -> captured = NULL;
+	screen -> captured_length = 0;
+	screen -> captured_size = 0;
+
+	if (!add_device(m, start, start, NULL, screen_write, screen)) {
+		return 0;
+	}
+	device_state(m, start, &screen -> state, sizeof(screen -> state));
+
+	return 1;
+}
+
+// Starts (or stops) keeping everything that gets printed
+void screen_capture(struct screen *screen, uint8_t on) {
+	screen -> capturing = on;
+
+	return;
+}
+
+// Everything captured so far (not 0 terminated), NULL if there isn't anything
+const char *screen_captured(struct screen *screen, size_t *length) {
+	*length = screen -> captured_length;
+
+	return screen -> captured;
+}
+
+// Flushes what's left and lets go of what was captured
+void free_screen(struct screen *screen) {
+	flush_screen(screen);
+	free(screen -> captured);
+	screen -> captured = NULL;
+	screen -> captured_length = 0;
+	screen -> captured_size = 0;
+
+	return;
+}
@@ -15,6 +15,7 @@
 #include <stdint.h>
 #include <string.h>
 #include <errno.h>
+#include <sys/stat.h>
 
 /*
 Custom input output range (Inside the RAM range). Address 1FFFFF is "wired up" 
@@ -26,66 +27,256 @@ terminal.
 */
 const uint32_t IO_RANGE[2] = {0x0FFF00, 0x0FFFFF};
 
+// The keyboard's registers (see keyboard.c), just after the 250 bytes MTA_KYB_IP puts lines in
+#define KEYBOARD_START 0x0FFFFA
+#define KEYBOARD_IRQ 0
+
+// The ROM image made from the program (see memory.c), and the hash of the program it was made from
+#define ROM_IMAGE "prog.rom"
+#define ROM_KEY "prog.rom.key"
+
+// prog.txt as a program image (see image.c), used instead of prog.txt when it's newer
+#define PROG_IMAGE "prog.img"
+
+// Returns 1 if file is there and newer than other (or other isn't there)
+uint8_t is_newer(const char *file, const char *other) {
+	struct stat file_stat, other_stat;
+
+	if (stat(file, &file_stat) != 0) {
+		return 0;
+	}
+	if (stat(other, &other_stat) != 0) {
+		return 1;
+	}
+
+	return file_stat.st_mtime > other_stat.st_mtime;
+}
+
+// The machine at its first prompt (a snapshot, see snapshot.c), what it printed on the way, and the hash of the program it was booted from
+#define BOOT_SNAPSHOT "boot.snap"
+#define BOOT_OUTPUT "boot.out"
+#define BOOT_KEY "boot.key"
+
+// FNV-1a of the whole file, 0 if it couldn't read it
+uint32_t hash_file(const char *path) {
+	uint8_t buffer[65536];
+	uint32_t hash = FNV_START;
+	size_t got;
+
+	FILE *fptr = fopen(path, "rb");
+	if (fptr == NULL) {
+		return 0;
+	}
+	while ((got = fread(buffer, 1, sizeof(buffer), fptr)) > 0) {
+		hash = fnv1a(hash, buffer, got);
+	}
+	fclose(fptr);
+
+	return hash;
+}
+
+// The key in path (ROM_KEY or BOOT_KEY), 0 if there isn't one
+uint32_t read_key(const char *path) {
+	unsigned int key = 0;
+
+	FILE *fptr = fopen(path, "r");
+	if (fptr == NULL) {
+		return 0;
+	}
+	if (fscanf(fptr, "%x", &key) != 1) {
+		key = 0;
+	}
+	fclose(fptr);
+
+	return key;
+}
+
+// Puts key in path, for read_key(). Returns 0 if it couldn't.
+uint8_t write_key(const char *path, uint32_t key) {
+	FILE *fptr = fopen(path, "w");
+	if (fptr == NULL) {
+		return 0;
+	}
+	fprintf(fptr, "%08x\n", key);
+
+	return fclose(fptr) == 0;
+}
+
+// Returns the whole file (free() it), or NULL if it couldn't read it
+char *read_file(const char *path, size_t *length) {
+	FILE *fptr = fopen(path, "rb");
+	if (fptr == NULL) {
+		return NULL;
+	}
+	fseek(fptr, 0, SEEK_END);
+	long size = ftell(fptr);
+	rewind(fptr);
+
+	char *text = (size < 0) ? NULL : (char*) malloc(size + 1); // + 1 so an empty one isn't NULL
+	if (text != NULL && fread(text, 1, size, fptr) != (size_t) size) {
+		free(text);
+		text = NULL;
+	}
+	fclose(fptr);
+	*length = size;
+
+	return text;
+}
+
+void save_boot(struct machine *m, struct screen *screen, uint32_t key) {
+	size_t length;
+	const char *output = screen_captured(screen, &length);
+
+	// The old key goes first, so a snapshot that's only half replaced never looks like it's for this program
+	remove(BOOT_KEY);
+	if (!write_snapshot(m, BOOT_SNAPSHOT, SNAPSHOT_MAPPABLE)) { // Mapped like the ROM image, so every run shares it
+		return;
+	}
+
+	FILE *fptr = fopen(BOOT_OUTPUT, "wb");
+	if (fptr == NULL) {
+		return;
+	}
+	fwrite(output, 1, length, fptr);
+	if (fclose(fptr) != 0) {
+		return;
+	}
+
+	write_key(BOOT_KEY, key);
+
+	return;
+}
+
+// Everything up to the first time it waits for the keyboard is the same every time it runs
+uint8_t at_prompt(struct machine *m, void *ctx) {
+	return m -> mem[m -> data.PC] == MTA_KYB_IP;
+}
+
 int main() {
 	// Set the testing mode: 0 is no debug info, 1 is some (e.g printing the address), 
 	// 2 is more (e.g printing addresses jumped to), 3 is most (e.g printing values 
 	// pushed to/pulled from the stack), 4 is everything (e.g printing the registers)
 	uint8_t testing_mode = 0;
-	
-	// Make the data struct that contains all of the register info
-	struct data data;
-	data.clk = 0;
-	data.cyclenum = 0;
 
-	// Make the memory
-	uint8_t *mem = (uint8_t*) malloc(1024 * 1024 * 16); // 16 megs wow!
+	// Set the engine: ENGINE_SWITCH is the plain switch in execute(), ENGINE_THREADED
+	// is faster, ENGINE_CHECKED runs both and stops if they ever disagree (slow)
+	uint8_t engine = ENGINE_THREADED;
 	
-	// This is just so the program is out of the way and it's easier to navigate main.
-	FILE *fptr;
+	// Make the memory (16 megs wow! It only really uses what the program writes to, see memory.c)
+	uint8_t *mem = make_mem();
+	if (mem == NULL) {
+		perror("Failed to allocate memory");
+		return 1;
+	}
 
-	fptr = fopen("prog.txt", "r");
+	// Make the machine (the data struct that contains all of the register info, the
+	// memory and the settings)
+	struct machine m;
+	init_machine(&m, mem, testing_mode, engine, &mem[IO_RANGE[0]]);
 
-	if (fptr == NULL) {
-		perror("AHHH ABORT ABORT FAILED TO OPEN FILE!!! AH!!!!");
-		return 1;
+	// Put the screen on its control byte (what it's in the middle of goes in the boot snapshot too)
+	static struct screen screen;
+	add_screen(&m, &screen, IO_RANGE[1], STDOUT_FILENO);
+	if (testing_mode > 0) {
+		screen.flush_cycles = 0; // Straight out, so it's in the right place among the debug info
 	}
+
+	// Input gets read as it comes in, so a run waiting for a line stops instead of blocking in fgets()
+	static struct keyboard keyboard;
+	if (!add_keyboard(&m, &keyboard, KEYBOARD_START, STDIN_FILENO, KEYBOARD_IRQ)) {
+		perror("Failed to start the keyboard"); // MTA_KYB_IP just reads stdin itself then
+	}
+
+	// The program's prog.img if it's newer and prog.txt otherwise, and everything's keyed on that one
+	uint8_t from_image = is_newer(PROG_IMAGE, "prog.txt");
+	const char *source = from_image ? PROG_IMAGE : "prog.txt";
+	uint32_t key = hash_file(source);
+
+	// If this program's been booted before, carry on from its first prompt instead of booting it
+	// again (not when debugging, the debug info from booting wouldn't come out)
+	size_t boot_length = 0;
+	char *boot_output = (testing_mode == 0 && key != 0 && read_key(BOOT_KEY) == key) ? read_file(BOOT_OUTPUT, &boot_length) : NULL;
+	uint8_t tried_snapshot = (boot_output != NULL);
+	if (tried_snapshot && load_snapshot(&m, BOOT_SNAPSHOT)) {
+		screen_output(&screen, boot_output, boot_length);
+		free(boot_output);
+	} else {
+		free(boot_output);
+
+		// A snapshot that goes wrong on a page has already put half of itself in memory, so boot from nothing
+		if (tried_snapshot) {
+			zero_mem(mem, 0, MAX_MEM + 1);
+			memset(&screen.state, 0, sizeof(screen.state));
+		}
+
+		// Map the ROM image if it was made from this program (going by its hash, the file
+		// times can't be trusted after a copy or a checkout), otherwise load the program
+		// image if there's a newer one than prog.txt, otherwise read prog.txt the slow way.
+		// Either of those makes a new ROM image for next time.
+		if (key == 0 || read_key(ROM_KEY) != key || !map_rom(mem, ROM_IMAGE, ROM_RANGE[0])) {
+			zero_mem(mem, 0, MAX_MEM + 1); // A ROM image that only half mapped leaves bits of itself behind
+			if (!from_image || !load_image(mem, PROG_IMAGE)) {
+				// So does a bad program image (see load_image()), and it's prog.txt everything's keyed on now
+				if (from_image) {
+					zero_mem(mem, 0, MAX_MEM + 1);
+					key = hash_file("prog.txt");
+				}
+				FILE *fptr;
+
+				fptr = fopen("prog.txt", "r");
+
+				if (fptr == NULL) {
+					perror("AHHH ABORT ABORT FAILED TO OPEN FILE!!! AH!!!!");
+					return 1;
+				}
 	
-	initialise_mem(data, mem);
+				loadProgFromFile(m.data, mem, fptr);
 
-	loadProgFromFile(data, mem, fptr);
+				fclose(fptr);
+			}
 
-	fclose(fptr);
+			// prog.txt should only have the ROM in it (that's all MTA_SAV_IP saves), if it's got more an image won't do
+			uint8_t only_rom = 1;
+			for (uint32_t i = 0; i < ROM_RANGE[0]; i += PAGE_SIZE) {
+				only_rom &= page_is_zero(&mem[i]);
+			}
+			// The old key goes first, so a half written image is never taken for this program's
+			if (only_rom && key != 0) {
+				remove(ROM_KEY);
+				if (write_rom(mem, ROM_IMAGE, ROM_RANGE[0], ROM_RANGE[1])) { // If it can't, it just reads prog.txt again next time
+					write_key(ROM_KEY, key);
+				}
+			}
+		}
 
-	/* 
-	Initialise the memory (zero the drive) and data (Setting the clock cycles to 
-	0, activating it, etc). Note: It is important to load the program before resetting 
-	data, as it will look for a vector at 0xFFFC and 0xFFFD.
-	*/
-	reset(&data, mem);
-
-	// Execute the program
-	int alreadyPrinted = 0;
-	int alreadyPrintedToScr = 0;
-	int nextFree = 0;
-	char string[(IO_RANGE[1] - IO_RANGE[0]) - 2];
-	while (data.clk == 1) {
-		execute(&data, mem, &data.PC, testing_mode, &mem[IO_RANGE[0]]);
-		// Custom screen component
-		if ((mem[IO_RANGE[1]] & 0b00000001) > 0) {
-			if (alreadyPrinted == 0) {
-				string[nextFree] = mem[IO_RANGE[1] - 1];
-				nextFree++;
-                if (testing_mode > 1) {
-                    printf("char set: %02x\n", string[nextFree - 1]);
-                }
+		/* 
+		Initialise the data (Setting the clock cycles to 0, activating it, etc). Note: It 
+		is important to load the program before resetting data, as it will look for a 
+		vector at 0xFFFC and 0xFFFD.
+		*/
+		reset(&m.data, mem);
+
+		// Boot it up to the first prompt and save it there for next time
+		if (testing_mode == 0 && key != 0) {
+			screen_capture(&screen, 1);
+			run_until(&m, at_prompt, NULL);
+			if (m.data.clk == 1) {
+				save_boot(&m, &screen, key);
 			}
-			alreadyPrinted = 1;
+			screen_capture(&screen, 0);
+		}
+	}
+
+	// Execute the program (the screen prints as it goes)
+	while (m.data.clk == 1) {
+		// Every instruction when debugging, so the debug info below still comes out after each one
+		uint8_t reason = (testing_mode > 0) ? run_steps(&m, 1) : run_for(&m, 1000000);
+		// It's waiting for a line, so sleep until there is one
+		if (reason == STOP_WAITING) {
+			flush_screen(&screen); // So the prompt's there while it waits
+			wait_keyboard(&keyboard);
 		} else {
-			alreadyPrinted = 0;
-            if (testing_mode > 2)
-            {
-                printf("Addr cleared: %06x\n", data.PC);
-            }
+			tick_screen(&screen);
 		}
         if (testing_mode > 3)
         {
@@ -95,25 +286,16 @@ int main() {
         if (testing_mode > 0) {
 			printf("\n");
 		}
-		if ((mem[IO_RANGE[1]] & 0b0000010) > 0) {
-			if (alreadyPrintedToScr == 0) {
-				string[nextFree] = '\0';
-				printf("%s", string);
-				if ((mem[IO_RANGE[1]] & 0b00000100) > 0) {
-					memset(string, 0, ((IO_RANGE[1] - IO_RANGE[0]) - 2));
-					nextFree = 0;
-				}
-			}
-			alreadyPrintedToScr = 1;
-		} else {
-			alreadyPrintedToScr = 0;
-		}
 	}
 
+	// Whatever it printed last goes before the debug info
+	free_screen(&screen);
+
 	// Print some debug info
-	printf("Clock cycles: %d\n", data.cyclenum);
-	printf("Final address: %06x\n", (data.PC - 1) & 0xFFFFFF);
+	printf("Clock cycles: %llu\n", (unsigned long long) cycles_run(&m));
+	printf("Instructions: %llu\n", (unsigned long long) instructions_run(&m));
+	printf("Final address: %06x\n", (m.data.PC - 1) & 0xFFFFFF);
 
-	printf("addr: %02x\n", data.PC);
+	printf("addr: %02x\n", m.data.PC);
 	return 0;
 }
\ No newline at end of file
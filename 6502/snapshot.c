@@ -0,0 +1,556 @@
+/*******************************************************
+
+Snapshots: everything about a machine in one file, so it
+can carry on from exactly there later (or somewhere else).
+
+Getting Sigma OS to a prompt means loading it, reset()
+and running the whole bootloader every time, and a long
+run that gets killed has to start again from nothing. A
+snapshot has the registers, every page of memory that
+isn't all zeros and the state of every device that has
+some (see device_state() in bus.c), so load_snapshot()
+puts a machine back where write_snapshot() was in a few
+ms, however long it took to get there.
+
+The file (everything little endian):
+	the header:
+		"6502SNAP"  8 bytes
+		version     4 bytes (SNAPSHOT_VERSION)
+		flags       4 bytes (SNAPSHOT_...)
+		pages       4 bytes, how many there are
+		devices     4 bytes, how many there are
+		checksum    4 bytes, FNV-1a of everything from the
+		            registers to the end of the page list
+		data        4 bytes, where the first page starts
+	the registers (SNAPSHOT_REGISTERS_SIZE bytes):
+		flags       1 byte, NV-BDIZC like PHP plus clk in bit 5
+		SP, exit code, A, X, Y, (a spare byte)
+		PC          4 bytes
+		cycles      8 bytes
+		instructions 8 bytes
+	then each device:
+		start       4 bytes
+		size        4 bytes
+		its state
+	then each page:
+		page        4 bytes, which one (address >> PAGE_SHIFT)
+		offset      4 bytes, where it is in the file
+		length      4 bytes, PAGE_SIZE if it's not compressed
+		checksum    4 bytes, FNV-1a of the length bytes
+	then all of the pages.
+
+Pages are compressed on their own with the little LZ
+codec below (the same idea as LZ4: runs of bytes that
+aren't worth anything get copied as they are, anything
+that's been seen before in the page is just where it was
+and how long), which is fast both ways and does well on
+programs and the mostly empty pages around them. A page
+it can't make any smaller is just stored as it is.
+
+SNAPSHOT_MAPPABLE leaves every page uncompressed and on
+its own page of the file instead, so load_snapshot() can
+mmap() them straight into memory like map_rom() does:
+nothing gets read off the disk until the program uses it,
+and every machine loaded from the same snapshot shares the
+pages it doesn't write to. Those pages don't get checked
+against their checksum then (that would mean reading them
+all). Either way the file itself gets mapped to load it,
+so nothing gets copied twice.
+
+The devices have to be put on the machine before loading
+it (they're the host's, same as forking), and they have to
+have the same starts and state sizes as when it was saved.
+Anything the machine had worked out from memory (the
+predecode cache, the JIT, the translated blocks) gets
+thrown away, and it starts out with nothing dirty.
+
+*******************************************************/
+
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HEADER_SIZE 32
+#define SNAPSHOT_REGISTERS_SIZE 28
+#define SNAPSHOT_PAGE_ENTRY 16
+
+// What the flags in a snapshot can say
+#define SNAPSHOT_MAPPABLE 0b00000001 // The pages aren't compressed and are all on their own page of the file
+
+// The LZ codec
+#define LZ_MIN_MATCH 4 // Anything shorter is just as small as literals
+#define LZ_HASH_BITS 12
+#define LZ_MAX_SIZE(length) ((length) + (length) / 255 + 16) // The most lz_compress() can make out of length bytes
+
+void put_u64(uint8_t *bytes, uint64_t value) {
+	put_u32(bytes, value);
+	put_u32(bytes + 4, value >> 32);
+
+	return;
+}
+
+uint64_t get_u64(const uint8_t *bytes) {
+	return get_u32(bytes) | ((uint64_t) get_u32(bytes + 4) << 32);
+}
+
+// Puts a length in the token's 4 bits, with the rest in bytes after it (255 means there's another one)
+uint32_t lz_length(uint8_t *out, uint32_t used, uint32_t length) {
+	if (length < 15) {
+		return used;
+	}
+	length -= 15;
+	while (length >= 255) {
+		out[used++] = 255;
+		length -= 255;
+	}
+	out[used++] = length;
+
+	return used;
+}
+
+// Adds one sequence (some literals and then a match, match is 0 for the last one which doesn't have one)
+uint32_t lz_sequence(uint8_t *out, uint32_t used, const uint8_t *literals, uint32_t literal_count, uint32_t offset, uint32_t match) {
+	uint8_t *token = &out[used++];
+	uint32_t match_code = match - LZ_MIN_MATCH;
+
+	*token = (literal_count < 15 ? literal_count : 15) << 4;
+	used = lz_length(out, used, literal_count);
+	memcpy(&out[used], literals, literal_count);
+	used += literal_count;
+	if (match == 0) {
+		return used;
+	}
+
+	*token |= match_code < 15 ? match_code : 15;
+	out[used++] = offset;
+	out[used++] = offset >> 8;
+	used = lz_length(out, used, match_code);
+
+	return used;
+}
+
+/*
+Compresses length bytes (up to 65535) from in into out, which needs room for
+LZ_MAX_SIZE(length). Returns how many bytes it made.
+*/
+uint32_t lz_compress(const uint8_t *in, uint32_t length, uint8_t *out) {
+	uint16_t seen[1 << LZ_HASH_BITS] = {0}; // Where (plus 1) each hash of 4 bytes was last
+	uint32_t used = 0;
+	uint32_t literals = 0; // Where the bytes that haven't been matched start
+	uint32_t i = 0;
+
+	while (i + LZ_MIN_MATCH <= length) {
+		uint32_t word;
+		memcpy(&word, &in[i], 4);
+		uint32_t hash = (word * 2654435761u) >> (32 - LZ_HASH_BITS);
+		uint32_t last = seen[hash];
+		seen[hash] = i + 1;
+
+		if (last == 0 || memcmp(&in[last - 1], &in[i], LZ_MIN_MATCH) != 0) {
+			i++;
+			continue;
+		}
+		last--;
+		uint32_t match = LZ_MIN_MATCH;
+		while (i + match < length && in[last + match] == in[i + match]) {
+			match++;
+		}
+		used = lz_sequence(out, used, &in[literals], i - literals, i - last, match);
+		i += match;
+		literals = i;
+	}
+
+	return lz_sequence(out, used, &in[literals], length - literals, 0, 0);
+}
+
+// Reads the rest of a length lz_length() wrote, returns 0 if it runs off the end of in
+uint8_t lz_read_length(const uint8_t *in, uint32_t in_length, uint32_t *i, uint32_t *length) {
+	uint8_t byte;
+
+	if (*length < 15) {
+		return 1;
+	}
+	do {
+		if (*i >= in_length) {
+			return 0;
+		}
+		byte = in[(*i)++];
+		*length += byte;
+	} while (byte == 255);
+
+	return 1;
+}
+
+/*
+Decompresses what lz_compress() made into out. Returns 0 if it isn't something
+lz_compress() could have made or it doesn't come to exactly length bytes.
+*/
+uint8_t lz_decompress(const uint8_t *in, uint32_t in_length, uint8_t *out, uint32_t length) {
+	uint32_t i = 0, o = 0;
+
+	while (i < in_length) {
+		uint8_t token = in[i++];
+
+		uint32_t count = token >> 4;
+		if (!lz_read_length(in, in_length, &i, &count) || count > in_length - i || count > length - o) {
+			return 0;
+		}
+		memcpy(&out[o], &in[i], count);
+		i += count;
+		o += count;
+		if (i == in_length) {
+			break; // The last one doesn't have a match
+		}
+
+		if (in_length - i < 2) {
+			return 0;
+		}
+		uint32_t offset = in[i] | (in[i + 1] << 8);
+		i += 2;
+		count = token & 15;
+		if (!lz_read_length(in, in_length, &i, &count)) {
+			return 0;
+		}
+		count += LZ_MIN_MATCH;
+		if (offset == 0 || offset > o || count > length - o) {
+			return 0;
+		}
+		if (offset >= count) {
+			memcpy(&out[o], &out[o - offset], count);
+			o += count;
+		} else {
+			// It overlaps what it's making (a run of the same few bytes), so one at a time
+			for (uint32_t j = 0; j < count; j++, o++) {
+				out[o] = out[o - offset];
+			}
+		}
+	}
+
+	return o == length;
+}
+
+// The registers as they go in a snapshot
+void put_registers(uint8_t *bytes, struct data *data) {
+	bytes[0] = GET_C(data) | (GET_Z(data) << 1) | (data -> I << 2) | (data -> D << 3) |
+		(data -> B << 4) | (data -> clk << 5) | (GET_V(data) << 6) | (GET_N(data) << 7);
+	bytes[1] = data -> SP;
+	bytes[2] = data -> exit_code;
+	bytes[3] = data -> A;
+	bytes[4] = data -> X;
+	bytes[5] = data -> Y;
+	bytes[6] = 0;
+	bytes[7] = 0;
+	put_u32(&bytes[8], data -> PC);
+	put_u64(&bytes[12], data -> cyclenum);
+	put_u64(&bytes[20], data -> instructions);
+
+	return;
+}
+
+void get_registers(const uint8_t *bytes, struct data *data) {
+	memset(data, 0, sizeof(*data));
+	SET_C(data, bytes[0]);
+	SET_Z(data, bytes[0] >> 1);
+	data -> I = bytes[0] >> 2;
+	data -> D = bytes[0] >> 3;
+	data -> B = bytes[0] >> 4;
+	data -> clk = bytes[0] >> 5;
+	SET_V(data, bytes[0] >> 6);
+	SET_N(data, bytes[0] >> 7);
+	data -> SP = bytes[1];
+	data -> exit_code = bytes[2];
+	data -> A = bytes[3];
+	data -> X = bytes[4];
+	data -> Y = bytes[5];
+	data -> PC = get_u32(&bytes[8]);
+	data -> cyclenum = get_u64(&bytes[12]);
+	data -> instructions = get_u64(&bytes[20]);
+
+	return;
+}
+
+/*
+Saves the machine as a snapshot, flags is SNAPSHOT_... (0 for a normal compressed one).
+Like write_image() it goes to a temporary file first and gets renamed over path at the
+end. Returns 0 if it couldn't write it.
+*/
+uint8_t write_snapshot(struct machine *m, const char *path, uint32_t flags) {
+	char temp_path[300];
+	uint8_t header[SNAPSHOT_HEADER_SIZE];
+	uint8_t registers[SNAPSHOT_REGISTERS_SIZE];
+	uint8_t compressed[LZ_MAX_SIZE(PAGE_SIZE)];
+	uint32_t checksum = FNV_START;
+	uint32_t page_count = 0;
+
+	for (uint32_t page = 0; page < PAGE_COUNT; page++) {
+		page_count += !page_is_zero(&m -> mem[page << PAGE_SHIFT]);
+	}
+	uint8_t *entries = (uint8_t*) malloc(page_count * SNAPSHOT_PAGE_ENTRY + 1);
+	if (entries == NULL) {
+		return 0;
+	}
+	FILE *fptr = open_temp(path, temp_path, sizeof(temp_path));
+	if (fptr == NULL) {
+		free(entries);
+		return 0;
+	}
+
+	fseek(fptr, SNAPSHOT_HEADER_SIZE, SEEK_SET); // The header goes in at the end, like write_image()
+	put_registers(registers, &m -> data);
+	fwrite(registers, 1, sizeof(registers), fptr);
+	checksum = fnv1a(checksum, registers, sizeof(registers));
+
+	for (uint8_t i = 0; i < m -> device_count; i++) {
+		uint8_t device_header[8];
+		put_u32(&device_header[0], m -> devices[i].start);
+		put_u32(&device_header[4], m -> devices[i].state_size);
+		fwrite(device_header, 1, sizeof(device_header), fptr);
+		fwrite(m -> devices[i].state, 1, m -> devices[i].state_size, fptr);
+		checksum = fnv1a(checksum, device_header, sizeof(device_header));
+		checksum = fnv1a(checksum, (const uint8_t*) m -> devices[i].state, m -> devices[i].state_size);
+	}
+
+	// The page list's size is known already, so the pages go straight after where it's going to be
+	uint32_t list_start = ftell(fptr);
+	uint32_t offset = list_start + page_count * SNAPSHOT_PAGE_ENTRY;
+	if (flags & SNAPSHOT_MAPPABLE) {
+		offset = (offset + PAGE_MASK) & ~PAGE_MASK;
+	}
+	uint32_t data_start = offset;
+
+	uint32_t n = 0;
+	for (uint32_t page = 0; page < PAGE_COUNT && n < page_count; page++) {
+		const uint8_t *bytes = &m -> mem[page << PAGE_SHIFT];
+		uint32_t length = PAGE_SIZE;
+		if (page_is_zero(bytes)) {
+			continue;
+		}
+		if (!(flags & SNAPSHOT_MAPPABLE)) {
+			uint32_t size = lz_compress(bytes, PAGE_SIZE, compressed);
+			if (size < PAGE_SIZE) {
+				bytes = compressed;
+				length = size;
+			}
+		}
+
+		uint8_t *entry = &entries[n * SNAPSHOT_PAGE_ENTRY];
+		put_u32(&entry[0], page);
+		put_u32(&entry[4], offset);
+		put_u32(&entry[8], length);
+		put_u32(&entry[12], fnv1a(FNV_START, bytes, length));
+		fseek(fptr, offset, SEEK_SET);
+		fwrite(bytes, 1, length, fptr);
+		offset += length;
+		n++;
+	}
+
+	fseek(fptr, list_start, SEEK_SET);
+	fwrite(entries, 1, n * SNAPSHOT_PAGE_ENTRY, fptr);
+	checksum = fnv1a(checksum, entries, n * SNAPSHOT_PAGE_ENTRY);
+	free(entries);
+
+	memcpy(header, "6502SNAP", 8);
+	put_u32(&header[8], SNAPSHOT_VERSION);
+	put_u32(&header[12], flags);
+	put_u32(&header[16], n);
+	put_u32(&header[20], m -> device_count);
+	put_u32(&header[24], checksum);
+	put_u32(&header[28], data_start);
+	fseek(fptr, 0, SEEK_SET);
+	fwrite(header, 1, sizeof(header), fptr);
+
+	uint8_t failed = ferror(fptr);
+	failed |= (fclose(fptr) != 0);
+	if (failed || rename(temp_path, path) != 0) {
+		remove(temp_path);
+		return 0;
+	}
+
+	return 1;
+}
+
+// Called when all of memory has been replaced, anything worked out from what was there is wrong now
+void forget_memory(struct machine *m) {
+	free(m -> code);
+	m -> code = NULL;
+	free_jit(m);
+	m -> jit_last = NULL;
+	if (m -> aot != NULL) {
+		use_aot(m, m -> aot);
+	}
+	free_mem(m -> checked_mem);
+	m -> checked_mem = NULL;
+	if (m -> fork_fd >= 0) {
+		fork_written(m);
+	}
+	for (uint32_t i = 0; i <= PAGE_COUNT; i++) {
+		m -> page_flags[i] &= ~(PAGE_CODE | PAGE_JIT | PAGE_SAVED);
+	}
+	clear_dirty(m);
+	m -> idle_at = IDLE_NONE;
+	if (m -> io_watching) {
+		m -> io_last = m -> mem[m -> io_watch];
+	}
+
+	return;
+}
+
+/*
+Checks everything before the pages (the header, the registers, the devices and the page
+list), returns the page list or NULL if something's wrong.
+*/
+const uint8_t *check_snapshot(struct machine *m, const uint8_t *file, size_t size) {
+	if (size < SNAPSHOT_HEADER_SIZE + SNAPSHOT_REGISTERS_SIZE || memcmp(file, "6502SNAP", 8) != 0 ||
+		get_u32(&file[8]) > SNAPSHOT_VERSION) {
+		return NULL;
+	}
+	uint32_t page_count = get_u32(&file[16]);
+	uint32_t device_count = get_u32(&file[20]);
+	uint32_t data_start = get_u32(&file[28]);
+	if (device_count != m -> device_count || page_count > PAGE_COUNT || data_start > size) {
+		return NULL;
+	}
+
+	size_t at = SNAPSHOT_HEADER_SIZE + SNAPSHOT_REGISTERS_SIZE;
+	for (uint32_t i = 0; i < device_count; i++) {
+		if (size - at < 8 || get_u32(&file[at]) != m -> devices[i].start ||
+			get_u32(&file[at + 4]) != m -> devices[i].state_size || size - at - 8 < m -> devices[i].state_size) {
+			return NULL;
+		}
+		at += 8 + m -> devices[i].state_size;
+	}
+
+	const uint8_t *entries = &file[at];
+	if (size - at < (size_t) page_count * SNAPSHOT_PAGE_ENTRY) {
+		return NULL;
+	}
+	at += page_count * SNAPSHOT_PAGE_ENTRY;
+	if (fnv1a(FNV_START, &file[SNAPSHOT_HEADER_SIZE], at - SNAPSHOT_HEADER_SIZE) != get_u32(&file[24])) {
+		return NULL;
+	}
+
+	for (uint32_t i = 0; i < page_count; i++) {
+		const uint8_t *entry = &entries[i * SNAPSHOT_PAGE_ENTRY];
+		uint32_t offset = get_u32(&entry[4]);
+		uint32_t length = get_u32(&entry[8]);
+		if (get_u32(&entry[0]) >= PAGE_COUNT || length > PAGE_SIZE || offset > size || length > size - offset) {
+			return NULL;
+		}
+	}
+
+	return entries;
+}
+
+/*
+Puts the machine back to how it was when the snapshot at path was saved. The machine has
+to have been set up with init_machine() (memory from make_mem()) and have the same devices.
+Returns 0 if it's not a snapshot, it's from a newer version, it doesn't match the devices
+or it's been cut off (the machine's as it was then), or a page is wrong (memory's only
+half loaded then, but the registers are still as they were).
+*/
+uint8_t load_snapshot(struct machine *m, const char *path) {
+	struct stat file_stat;
+	uint8_t *file = NULL;
+	uint8_t mapped = 0;
+	uint8_t ok = 1;
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return 0;
+	}
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size < SNAPSHOT_HEADER_SIZE) {
+		close(fd);
+		return 0;
+	}
+	size_t size = file_stat.st_size;
+
+#ifdef MAP_ANONYMOUS
+	void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map != MAP_FAILED) {
+		file = (uint8_t*) map;
+		mapped = 1;
+	}
+#endif
+	if (!mapped) {
+		file = (uint8_t*) malloc(size);
+		if (file == NULL || pread(fd, file, size, 0) != (ssize_t) size) {
+			free(file);
+			close(fd);
+			return 0;
+		}
+	}
+
+	const uint8_t *entries = check_snapshot(m, file, size);
+	if (entries == NULL) {
+		ok = 0;
+		goto done;
+	}
+	uint32_t page_count = get_u32(&file[16]);
+	uint8_t can_map = mapped && (get_u32(&file[12]) & SNAPSHOT_MAPPABLE) &&
+		(uintptr_t) m -> mem % sysconf(_SC_PAGESIZE) == 0 && PAGE_SIZE % sysconf(_SC_PAGESIZE) == 0;
+
+	// Anything that isn't in the snapshot is all zeros
+	uint32_t gap = 0; // The first page after the last one in the snapshot
+	for (uint32_t i = 0; i <= page_count; i++) {
+		uint32_t page = (i < page_count) ? get_u32(&entries[i * SNAPSHOT_PAGE_ENTRY]) : PAGE_COUNT;
+		if (page > gap) {
+			zero_mem(m -> mem, gap << PAGE_SHIFT, (page - gap) << PAGE_SHIFT);
+		}
+		gap = page + 1;
+	}
+
+	for (uint32_t i = 0; i < page_count && ok; i++) {
+		const uint8_t *entry = &entries[i * SNAPSHOT_PAGE_ENTRY];
+		uint32_t page = get_u32(&entry[0]);
+		uint32_t offset = get_u32(&entry[4]);
+		uint32_t length = get_u32(&entry[8]);
+
+#ifdef MAP_ANONYMOUS
+		if (can_map && length == PAGE_SIZE) {
+			// All the pages after it that are next to it in memory and in the file go in the same mapping
+			uint32_t run = 1;
+			while (i + run < page_count && get_u32(&entry[run * SNAPSHOT_PAGE_ENTRY]) == page + run &&
+				get_u32(&entry[run * SNAPSHOT_PAGE_ENTRY + 4]) == offset + run * PAGE_SIZE &&
+				get_u32(&entry[run * SNAPSHOT_PAGE_ENTRY + 8]) == PAGE_SIZE) {
+				run++;
+			}
+			// Over the top of what's there, like map_rom()
+			if (mmap(&m -> mem[page << PAGE_SHIFT], run * PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+				fd, offset) != MAP_FAILED) {
+				i += run - 1;
+				continue;
+			}
+		}
+#endif
+		if (fnv1a(FNV_START, &file[offset], length) != get_u32(&entry[12])) {
+			ok = 0;
+		} else if (length == PAGE_SIZE) {
+			memcpy(&m -> mem[page << PAGE_SHIFT], &file[offset], PAGE_SIZE);
+		} else {
+			ok = lz_decompress(&file[offset], length, &m -> mem[page << PAGE_SHIFT], PAGE_SIZE);
+		}
+	}
+
+	if (ok) {
+		get_registers(&file[SNAPSHOT_HEADER_SIZE], &m -> data);
+		size_t at = SNAPSHOT_HEADER_SIZE + SNAPSHOT_REGISTERS_SIZE;
+		for (uint8_t i = 0; i < m -> device_count; i++) {
+			memcpy(m -> devices[i].state, &file[at + 8], m -> devices[i].state_size);
+			at += 8 + m -> devices[i].state_size;
+		}
+	}
+	forget_memory(m);
+
+done:
+#ifdef MAP_ANONYMOUS
+	if (mapped) {
+		munmap(file, size);
+	}
+#endif
+	if (!mapped) {
+		free(file);
+	}
+	close(fd);
+
+	return ok;
+}
@@ -0,0 +1,196 @@
+/*
+The switch and threaded engines, as run_switch_<VARIANT>() and run_threaded_<VARIANT>().
+dispatch.c includes this once for every variant (same idea as execute.c), and the
+machine picks the right one when it's made.
+*/
+
+/*
+The same switch as execute(), except it's got the machine, so its reads and writes go
+through the machine like the other engines' (execute() on its own only has the memory).
+*/
+uint8_t PASTE(run_switch_, VARIANT)(RUN_ARGS) {
+	const uint8_t testing_mode = TESTING_MODE;
+	MACHINE_LOCALS
+	INSTRUCTION_LOCALS
+
+	// Anything that came in while it wasn't running (like an event going off, see events.c)
+	if (INTERRUPT_PENDING(m)) {
+		take_irq(m);
+	}
+
+	while (1) {
+		EXECUTE_PROLOGUE
+		switch (mem[*address]) {
+#define OP(opcode) case opcode: data -> cyclenum += instruction_cycles[opcode];
+#define END_OP break;
+#define OP_BAIL goto stop
+#define OPERAND_BYTE mem[*address]
+#define OPERAND_ABS getAddr(data, address, mem)
+#define LOAD(a) load_byte(m, a)
+#define STORE(a, v) store_byte(m, a, v)
+#define WROTE(a, length) bytes_written(m, a, length)
+#define PUSH(v) push_byte(m, v, testing_mode)
+#define POP() pop_byte(m, testing_mode)
+#define SAVE_PROG() start_save(m)
+#define KEYBOARD_LINE() keyboard_line(m)
+#define WAIT_INPUT { reason = STOP_WAITING; goto stop; }
+#include "instruction_bodies.c"
+#undef OP
+#undef END_OP
+#undef OP_BAIL
+#undef OPERAND_BYTE
+#undef OPERAND_ABS
+#undef LOAD
+#undef STORE
+#undef WROTE
+#undef PUSH
+#undef POP
+#undef SAVE_PROG
+#undef KEYBOARD_LINE
+#undef WAIT_INPUT
+			default:
+				printf("Unrecognised instruction %02x at address: %06x\n", mem[*address], *address);
+		}
+		EXECUTE_EPILOGUE
+		(*address)++;
+		CHECK_STOP
+	}
+
+stop:
+	data -> instructions += done;
+	return reason;
+}
+
+uint8_t PASTE(run_threaded_, VARIANT)(RUN_ARGS) {
+#if defined(__GNUC__)
+	const uint8_t testing_mode = TESTING_MODE;
+	MACHINE_LOCALS
+	INSTRUCTION_LOCALS
+	struct predecoded *code = m -> code;
+	struct predecoded *entry;
+	uint32_t operand;
+	static void *table[256];
+	static void *fused[256]; // The first halves of superinstructions (see predecode.c)
+	static uint8_t built = 0;
+
+	if (INTERRUPT_PENDING(m)) {
+		take_irq(m);
+	}
+	if (code == NULL) {
+		if (!start_predecode(m)) {
+			return PASTE(run_switch_, VARIANT)(m, count, condition, ctx);
+		}
+		code = m -> code;
+	}
+	if (built) {
+		goto start;
+	}
+
+	/*
+	The first time through, this fills in the table instead of running anything. Every
+	body is wrapped in "if (0)" so it only ever gets reached through its label.
+	*/
+	for (int i = 0; i < 256; i++) {
+		table[i] = &&unknown;
+		fused[i] = NULL;
+	}
+
+/*
+Get the next instruction out of the predecode cache (decoding it if it isn't there)
+and go to it. The operand gets copied out first, so it doesn't matter if the
+instruction writes over itself.
+*/
+#define DISPATCH \
+	entry = &code[*address & CODE_CACHE_MASK]; \
+	if (entry -> address != *address) { \
+		entry = decode(m, *address, table, fused, &&idle); \
+	} \
+	operand = entry -> operand; \
+	goto *entry -> handler;
+
+// Finish the instruction, then go straight to the next one
+#define NEXT \
+	EXECUTE_EPILOGUE \
+	(*address)++; \
+	CHECK_STOP \
+	EXECUTE_PROLOGUE \
+	DISPATCH
+
+/*
+The end of the first half of a superinstruction: the same, except the second half's
+already in the entry. If the first half wrote over the second half the entry's gone,
+so it gets looked up like normal.
+*/
+#define FUSED_NEXT \
+	EXECUTE_EPILOGUE \
+	(*address)++; \
+	CHECK_STOP \
+	EXECUTE_PROLOGUE \
+	if (entry -> address + entry -> length != *address) { \
+		DISPATCH \
+	} \
+	operand = entry -> next_operand; \
+	goto *entry -> next;
+
+#define OP(opcode) table[opcode] = &&op_##opcode; if (0) { op_##opcode: data -> cyclenum += instruction_cycles[opcode];
+#define END_OP NEXT }
+#define OP_BAIL goto stop
+#define OPERAND_BYTE ((uint8_t) operand)
+#define OPERAND_ABS (*address += 2, operand)
+#define LOAD(a) load_byte(m, a)
+#define STORE(a, v) store_byte(m, a, v)
+#define WROTE(a, length) bytes_written(m, a, length)
+#define PUSH(v) push_byte(m, v, testing_mode)
+#define POP() pop_byte(m, testing_mode)
+#define SAVE_PROG() start_save(m)
+#define KEYBOARD_LINE() keyboard_line(m)
+#define WAIT_INPUT { reason = STOP_WAITING; goto stop; }
+#include "instruction_bodies.c"
+#undef OP
+#undef END_OP
+
+	// And again for the first halves (anything that isn't in a pair never gets used)
+#define OP(opcode) fused[opcode] = &&fused_##opcode; if (0) { fused_##opcode: data -> cyclenum += instruction_cycles[opcode];
+#define END_OP FUSED_NEXT }
+#include "instruction_bodies.c"
+#undef OP
+#undef END_OP
+#undef FUSED_NEXT
+#undef OP_BAIL
+#undef OPERAND_BYTE
+#undef OPERAND_ABS
+#undef LOAD
+#undef STORE
+#undef WROTE
+#undef PUSH
+#undef POP
+#undef SAVE_PROG
+#undef KEYBOARD_LINE
+#undef WAIT_INPUT
+
+	built = 1;
+
+start:
+	EXECUTE_PROLOGUE
+	DISPATCH
+
+idle:
+	// The jump at the bottom of what might be an idle loop (see idle.c), the real one's in next
+	if (testing_mode == 0 && condition == NULL) {
+		done += skip_idle(m, done, count);
+	}
+	goto *entry -> next;
+
+unknown:
+	printf("Unrecognised instruction %02x at address: %06x\n", mem[*address], *address);
+	NEXT
+#undef NEXT
+#undef DISPATCH
+
+stop:
+	data -> instructions += done;
+	return reason;
+#else
+	return PASTE(run_switch_, VARIANT)(m, count, condition, ctx);
+#endif
+}
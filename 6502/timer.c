@@ -0,0 +1,191 @@
+/*******************************************************
+
+The timer: interrupting the program every so often.
+
+Without one a program that wants to wait for a while (or
+let something else have a go) can only go round a loop
+counting, which keeps the host just as busy as real work.
+With a timer it sets how long, gets on with something
+else (or waits in a loop the threaded engine can skip,
+see idle.c) and gets interrupted when it's up.
+
+add_timer() puts its registers on the bus at start:
+	start + 0 to 3 (TIMER_RELOAD): how many cycles it goes
+		for, little endian
+	start + 4 to 7 (TIMER_COUNT, read only): how many are
+		left (0 when it's not going)
+	start + 8 (TIMER_CONTROL): TIMER_... bits, writing
+		TIMER_ENABLE starts it from TIMER_RELOAD (again,
+		if it was already going), writing it without stops
+		it
+	start + 9 (TIMER_STATUS): TIMER_FIRED once it's gone
+		off, writing anything there clears that and lets
+		go of the IRQ line
+When it goes off it raises its IRQ source (and holds it
+until the program writes to TIMER_STATUS), or with
+TIMER_NMI it raises the NMI instead, which happens even
+with I set and doesn't need acknowledging. TIMER_PERIODIC
+starts it again straight away, counting from when it was
+meant to go off, otherwise TIMER_ENABLE goes back off.
+
+It's all done with an event (see events.c), so nothing
+checks the timer between instructions, the engine just
+stops at the cycle it goes off.
+
+Its state goes in snapshots, but its event doesn't (they
+never do), so after load_snapshot() the host has to call
+resume_timer() to start it back up.
+
+*******************************************************/
+
+// The registers, from start
+#define TIMER_RELOAD 0
+#define TIMER_COUNT 4
+#define TIMER_CONTROL 8
+#define TIMER_STATUS 9
+#define TIMER_SIZE 10
+
+// What TIMER_CONTROL says
+#define TIMER_ENABLE 0b00000001 // It's going
+#define TIMER_PERIODIC 0b00000010 // It starts again when it goes off
+#define TIMER_NMI 0b00000100 // It raises the NMI instead of its IRQ
+
+// What TIMER_STATUS says
+#define TIMER_FIRED 0b00000001
+
+// What goes in snapshots
+struct timer_state {
+	uint64_t due; // The cycle it goes off, if it's going
+	uint32_t reload; // What it was started with
+	uint8_t control;
+	uint8_t status;
+};
+
+struct timer {
+	struct timer_state state;
+
+	struct machine *m;
+	uint32_t start;
+	uint8_t source; // Its bit on the IRQ line
+};
+
+/*
+Puts value in the program's copy of a register, so reading it back gets it. Not through
+bytes_written(), that would tell the timer it got written to.
+*/
+void timer_register(struct timer *timer, uint32_t offset, uint8_t value) {
+	timer -> m -> mem[timer -> start + offset] = value;
+
+	return;
+}
+
+void timer_fire(struct machine *m, void *ctx, uint64_t cycle) {
+	struct timer *timer = (struct timer*) ctx;
+	struct timer_state *state = &timer -> state;
+
+	state -> status |= TIMER_FIRED;
+	timer_register(timer, TIMER_STATUS, state -> status);
+	if (state -> control & TIMER_NMI) {
+		raise_nmi(m);
+	} else {
+		raise_irq(m, timer -> source);
+	}
+
+	if (state -> control & TIMER_PERIODIC) {
+		state -> due = cycle + state -> reload;
+		schedule_event(m, state -> due, timer_fire, timer);
+	} else {
+		state -> control &= ~TIMER_ENABLE;
+		timer_register(timer, TIMER_CONTROL, state -> control);
+	}
+
+	return;
+}
+
+// Starts it going from TIMER_RELOAD, or stops it if TIMER_ENABLE is off (or the reload is 0)
+void start_timer(struct timer *timer) {
+	struct timer_state *state = &timer -> state;
+	uint8_t *reload = &timer -> m -> mem[timer -> start + TIMER_RELOAD];
+
+	cancel_events(timer -> m, timer_fire, timer);
+	state -> reload = reload[0] | (reload[1] << 8) | (reload[2] << 16) | ((uint32_t) reload[3] << 24);
+	if (state -> reload == 0) {
+		state -> control &= ~TIMER_ENABLE;
+		timer_register(timer, TIMER_CONTROL, state -> control);
+	}
+	if (!(state -> control & TIMER_ENABLE)) {
+		return;
+	}
+
+	state -> due = timer -> m -> data.cyclenum + state -> reload;
+	schedule_event(timer -> m, state -> due, timer_fire, timer);
+
+	return;
+}
+
+uint8_t timer_read(struct machine *m, void *ctx, uint32_t address) {
+	struct timer *timer = (struct timer*) ctx;
+	uint32_t offset = address - timer -> start;
+
+	if (offset >= TIMER_COUNT && offset < TIMER_COUNT + 4) {
+		uint64_t left = 0;
+		if ((timer -> state.control & TIMER_ENABLE) && timer -> state.due > m -> data.cyclenum) {
+			left = timer -> state.due - m -> data.cyclenum;
+		}
+		return left >> (8 * (offset - TIMER_COUNT));
+	}
+
+	return m -> mem[address];
+}
+
+void timer_write(struct machine *m, void *ctx, uint32_t address, uint8_t value) {
+	struct timer *timer = (struct timer*) ctx;
+
+	switch (address - timer -> start) {
+		case TIMER_CONTROL:
+			timer -> state.control = value;
+			start_timer(timer);
+			break;
+		case TIMER_STATUS:
+			timer -> state.status = 0;
+			timer_register(timer, TIMER_STATUS, 0);
+			lower_irq(m, timer -> source);
+			break;
+	}
+
+	return;
+}
+
+/*
+Puts a timer on the bus from start (to start + TIMER_SIZE - 1), interrupting on IRQ source
+"source" (0 to 30). It starts out stopped. Returns 0 if it couldn't.
+*/
+uint8_t add_timer(struct machine *m, struct timer *timer, uint32_t start, uint8_t source) {
+	memset(&timer -> state, 0, sizeof(timer -> state));
+	timer -> m = m;
+	timer -> start = start;
+	timer -> source = source;
+
+	if (source >= IRQ_NMI || !add_device(m, start, start + TIMER_SIZE - 1, timer_read, timer_write, timer)) {
+		return 0;
+	}
+	device_state(m, start, &timer -> state, sizeof(timer -> state));
+
+	return 1;
+}
+
+// Starts it back up from its state, after load_snapshot() put that back
+void resume_timer(struct timer *timer) {
+	cancel_events(timer -> m, timer_fire, timer);
+	if (timer -> state.control & TIMER_ENABLE) {
+		schedule_event(timer -> m, timer -> state.due, timer_fire, timer);
+	}
+	// The IRQ line isn't in snapshots either
+	if ((timer -> state.status & TIMER_FIRED) && !(timer -> state.control & TIMER_NMI)) {
+		raise_irq(timer -> m, timer -> source);
+	} else {
+		lower_irq(timer -> m, timer -> source);
+	}
+
+	return;
+}
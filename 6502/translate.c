@@ -0,0 +1,189 @@
+/*
+
+	Translates a prog.txt image into C ahead of time, for ENGINE_AOT
+	(see aot.c for how to use what it makes).
+
+		./translate prog.txt prog_aot.c prog
+
+	starts at the reset vector (and the interrupt vector), follows every
+	jump, branch and JSR it can (and JMP_ID to wherever it points in the
+	image), and writes a function for every block it
+	finds into prog_aot.c, plus "const struct aot_program prog_aot" with
+	all of them in it. Anything it can't follow is left for the
+	interpreter.
+
+*/
+
+#include "cpu6502.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MAX_BLOCKS 65536
+
+uint8_t *mem;
+uint8_t known[256]; // Opcodes with a body that's allowed to be translated
+uint8_t *started; // One byte per address, 1 if there's a block (or a try at one) there
+
+uint32_t queue[MAX_BLOCKS];
+uint32_t queued = 0;
+uint32_t blocks[MAX_BLOCKS];
+uint32_t block_count = 0;
+
+// Somewhere there should be a block (if it's code)
+void add_start(uint32_t address) {
+	if (address > MAX_MEM || started[address] || queued >= MAX_BLOCKS) {
+		return;
+	}
+	started[address] = 1;
+	queue[queued] = address;
+	queued++;
+
+	return;
+}
+
+/*
+Works out where the block at address ends, adding everywhere it can go next. Returns
+how many instructions are in it (0 if there's nothing to translate there).
+*/
+uint32_t follow_block(uint32_t address, uint32_t *span) {
+	uint32_t count = 0;
+	uint32_t i = address;
+
+	while (count < AOT_MAX_BLOCK && i + 3 <= MAX_MEM) {
+		uint8_t opcode = mem[i];
+		uint8_t length = length_of(opcode);
+		uint32_t operand = operand_at(mem, i, length);
+
+		if (!known[opcode]) {
+			// The interpreter does it, then the program carries on after it
+			if (opcode == MTA_SAV_IP || opcode == MTA_KYB_IP) {
+				add_start(i + 1);
+			}
+			break;
+		}
+		count++;
+		i += length;
+
+		if (is_jump(opcode)) {
+			add_start(branch_target(opcode, i - length, operand));
+			if (opcode != INS_JMP_AB) {
+				add_start(i);
+			}
+		} else if (opcode == INS_JSR_AB) {
+			add_start(operand);
+			add_start(i); // Where RTS comes back to
+		} else if (opcode == INS_JMP_ID && operand + 2 <= MAX_MEM) {
+			// Wherever it points now, the program might change it but then that block just won't get used
+			add_start(operand_at(mem, operand - 1, 4));
+		}
+		if (ends_block[opcode]) {
+			break;
+		}
+	}
+	if (count == AOT_MAX_BLOCK) {
+		add_start(i);
+	}
+	*span = i - address;
+
+	return count;
+}
+
+int compare_addresses(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t*) a, y = *(const uint32_t*) b;
+
+	return (x > y) - (x < y);
+}
+
+void write_block(FILE *out, const char *name, uint32_t address) {
+	uint32_t span;
+	uint32_t count = follow_block(address, &span);
+	uint32_t i = address;
+
+	fprintf(out, "uint32_t %s_block_%06x(struct machine *m) {\n", name, address);
+	fprintf(out, "\tstruct data *data = &m -> data;\n\n");
+	for (uint32_t n = 1; n <= count; n++) {
+		uint8_t opcode = mem[i];
+		uint8_t length = length_of(opcode);
+
+		fprintf(out, "\tdata -> PC = 0x%06x; aot_0x%02X(m, 0x%06x);\n", i, opcode, operand_at(mem, i, length));
+		if (writes_memory[opcode] && n < count) {
+			fprintf(out, "\tif (m -> jit_exit) {\n\t\tdata -> PC++;\n\t\treturn %u;\n\t}\n", n);
+		}
+		i += length;
+	}
+	fprintf(out, "\tdata -> PC++;\n\n\treturn %u;\n}\n\n", count);
+
+	return;
+}
+
+int main(int argc, char **argv) {
+	if (argc < 3) {
+		printf("Usage: %s prog.txt output.c [name]\n", argv[0]);
+		return 1;
+	}
+	const char *name = (argc > 3) ? argv[3] : "prog";
+
+	mem = (uint8_t*) calloc(MAX_MEM + 1, 1);
+	started = (uint8_t*) calloc(MAX_MEM + 1, 1);
+	if (mem == NULL || started == NULL) {
+		perror("Failed to allocate memory");
+		return 1;
+	}
+
+	FILE *fptr = fopen(argv[1], "r");
+	if (fptr == NULL) {
+		perror("AHHH ABORT ABORT FAILED TO OPEN FILE!!! AH!!!!");
+		return 1;
+	}
+	struct machine m;
+	init_machine(&m, mem, 0, ENGINE_SWITCH, mem);
+	loadProgFromFile(m.data, mem, fptr);
+	fclose(fptr);
+
+	find_instructions(&m, known);
+	known[MTA_OFF_IP] = known[MTA_SAV_IP] = known[MTA_OFS_IP] = known[MTA_KYB_IP] = 0;
+
+	// Follow everything from the reset and interrupt vectors (interrupts start one byte after theirs, see interrupts.c)
+	add_start(operand_at(mem, 0xFFFFF9, 4));
+	if (operand_at(mem, IRQ_VECTOR - 1, 4) != 0) {
+		add_start(operand_at(mem, IRQ_VECTOR - 1, 4) + 1);
+	}
+	if (operand_at(mem, NMI_VECTOR - 1, 4) != 0) {
+		add_start(operand_at(mem, NMI_VECTOR - 1, 4) + 1);
+	}
+	for (uint32_t i = 0; i < queued; i++) {
+		uint32_t span;
+		if (follow_block(queue[i], &span) > 0) {
+			blocks[block_count] = queue[i];
+			block_count++;
+		}
+	}
+	qsort(blocks, block_count, sizeof(uint32_t), compare_addresses);
+
+	FILE *out = fopen(argv[2], "w");
+	if (out == NULL) {
+		perror("Failed to open the output file");
+		return 1;
+	}
+	fprintf(out, "/*\nTranslated from %s by translate.c, don't edit it (translate it again instead).\n", argv[1]);
+	fprintf(out, "Include it after cpu6502.h and give %s_aot to use_aot().\n*/\n\n", name);
+	for (uint32_t i = 0; i < block_count; i++) {
+		write_block(out, name, blocks[i]);
+	}
+	fprintf(out, "const struct aot_block %s_blocks[] = {\n", name);
+	for (uint32_t i = 0; i < block_count; i++) {
+		uint32_t span;
+		uint32_t count = follow_block(blocks[i], &span);
+		fprintf(out, "\t{0x%06x, %u, %u, %s_block_%06x},\n", blocks[i], span, count, name, blocks[i]);
+	}
+	fprintf(out, "};\n\nconst struct aot_program %s_aot = {%s_blocks, %u};\n", name, name, block_count);
+	fclose(out);
+
+	printf("Translated %u blocks into %s\n", block_count, argv[2]);
+	free(mem);
+	free(started);
+
+	return 0;
+}